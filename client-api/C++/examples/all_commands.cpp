@@ -137,6 +137,8 @@ int main()
             VIBES_TEST( vibes::drawBox(box_bounds,vibesParams("group","blue group")) );
         }
         VIBES_TEST( vibes::setObjectProperty("blue group","format","cyan[blue]") );
+        VIBES_TEST( vibes::setObjectsProperties(vibesParams("group","red group","type","box"),
+                                                vibesParams("LineStyle","--")) );
     }
 
     cout << "Plotting y=sin(x) and y=cos(x)" << std::endl;
@@ -197,10 +199,50 @@ int main()
     VIBES_TEST( vibes::drawEllipse(-1,-1,2,3,30.0, vibesParams("name","ellipse")) );
     VIBES_TEST( vibes::removeObject("ellipse") );
 
+    VIBES_TEST( vibes::drawEllipse(-1,-1,2,3,60.0, vibesParams("name","ellipse 1")) );
+    VIBES_TEST( vibes::drawEllipse(-1,-1,2,3,90.0, vibesParams("name","ellipse 2")) );
+    VIBES_TEST( vibes::removeObjects(vibesParams("name","ellipse *")) );
+
     VIBES_TEST( vibesDrawEllipse(-1,-1,1.5,2,30.0, "parent",0.1, "g") );
 
     VIBES_TEST( vibes::drawEllipse(0,-4.75,4,0.25,0.0, "darkGray") );
 
+    cout << "drawConfidenceEllipses" << std::endl;
+    {
+        // Particles along a line, with growing uncertainty
+        vector< vector<double> > centers, covs;
+        for (int i = 0; i < 10; ++i) {
+            vector<double> center(2), cov(4);
+            center[0] = -10. + 2. * i; center[1] = -10.;
+            cov[0] = 0.01 * (i + 1); cov[1] = cov[2] = 0.005 * i; cov[3] = 0.02;
+            centers.push_back(center);
+            covs.push_back(cov);
+        }
+        VIBES_TEST( vibes::drawConfidenceEllipses(centers, covs, 3., "blue") );
+    }
+
+    cout << "drawLines and drawPolygons" << std::endl;
+    {
+        // Staircase of segments and row of triangles, as flat coordinates and offsets
+        vector<double> coords;
+        vector<int> offsets(1, 0);
+        for (int i = 0; i < 5; ++i) {
+            coords.push_back(-10. + 2. * i); coords.push_back(12. + i);
+            coords.push_back(-8. + 2. * i); coords.push_back(12. + i);
+            offsets.push_back(2 * (i + 1));
+        }
+        VIBES_TEST( vibes::drawLines(coords, offsets, "darkGreen") );
+        coords.clear();
+        offsets.assign(1, 0);
+        for (int i = 0; i < 5; ++i) {
+            coords.push_back(-10. + 2. * i); coords.push_back(18.);
+            coords.push_back(-9. + 2. * i); coords.push_back(19.5);
+            coords.push_back(-8. + 2. * i); coords.push_back(18.);
+            offsets.push_back(3 * (i + 1));
+        }
+        VIBES_TEST( vibes::drawPolygons(coords, offsets, "black[green]") );
+    }
+
     cout << "drawPolygon with vector of bounds" << std::endl;
     {
         vector<double> x, y;
@@ -218,6 +260,10 @@ int main()
     VIBES_TEST( vibes::drawVehicle(4, 36, 52, 5, "green") ); // cx, cy, rotation, length
     VIBES_TEST( vibes::drawVehicle(-5, 20, 0, 3, "blue[lightGray]") );
 
+    cout << "setPose" << std::endl;
+    VIBES_TEST( vibes::drawVehicle(10, 20, 0, 3, "red[lightGray]", vibesParams("name","moving vehicle")) );
+    VIBES_TEST( vibes::setPose("moving vehicle", 12, 24, 45) );
+
     cout << "drawAUV" << std::endl;
     VIBES_TEST( vibes::drawAUV(22, -16, 52, 5, "blue[yellow]") );
     VIBES_TEST( vibes::drawAUV(40, 0, 0, 3, "blue[green]") );
@@ -234,6 +280,18 @@ int main()
     VIBES_TEST( vibes::drawArrow(65., 70., 65., 50., 2., "black[red]") );
     VIBES_TEST( vibes::drawArrow(62., 50., 62., 70., 2., "black[red]") );
 
+    cout << "drawArrows" << std::endl;
+    {
+        // Rotating vector field, colored by magnitude
+        std::vector<double> x, y, vx, vy;
+        for (int i = -5; i <= 5; ++i)
+            for (int j = -5; j <= 5; ++j) {
+                x.push_back(80. + 4. * i); y.push_back(30. + 4. * j);
+                vx.push_back(-0.4 * j); vy.push_back(0.4 * i);
+            }
+        VIBES_TEST( vibes::drawArrows(x, y, vx, vy, 0., vibesParams("ColorMap","viridis")) );
+    }
+
     cout << "drawSector" << std::endl;
     VIBES_TEST( vibes::drawSector(0,0,3,3,20, 120, "black[red]") );
     VIBES_TEST( vibes::drawSector(0,0,3,1,-20, -220, "black[red]") );
@@ -246,6 +304,19 @@ int main()
     VIBES_TEST( vibes::drawPie(10,-20,3,4,700, 800, "black[red]") );
     VIBES_TEST( vibes::drawPie(5,-20,3,3,20, 120, "black[red]") );
 
+    cout << "drawPies" << std::endl;
+    {
+        // Polar paving around (30,-40)
+        std::vector<double> cx, cy, r_min, r_max, theta_min, theta_max;
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 12; ++j) {
+                cx.push_back(30.); cy.push_back(-40.);
+                r_min.push_back(2. + i); r_max.push_back(3. + i);
+                theta_min.push_back(30. * j); theta_max.push_back(30. * j + 30.);
+            }
+        VIBES_TEST( vibes::drawPies(cx, cy, r_min, r_max, theta_min, theta_max, "black[cyan]") );
+    }
+
     cout << "drawRing"<< endl;
     VIBES_TEST( vibes::drawRing(42,42,20,23,"black[red]"));
 
@@ -265,6 +336,10 @@ int main()
             boxes_bounds.push_back(box_bounds);
         }
         VIBES_TEST( vibes::drawBoxes(boxes_bounds,"red[y]") );
+        std::vector<double> levels;
+        for (int i=0; i<10; ++i)
+            levels.push_back(i);
+        VIBES_TEST( vibes::drawBoxes(boxes_bounds,levels,vibesParams("ColorMap","hot")) );
     }
 
     cout << "drawPoint"<<endl;
@@ -303,6 +378,17 @@ int main()
     }
 
     vibes::drawPoints(x,y,vibesParams("FaceColor","red","EdgeColor","darkRed","Radius",100));
+
+    // Points colored by their distance to the center, with growing radiuses
+    {
+        vector<double> levels, radiuses;
+        for (unsigned int i=0;i<x.size();i++)
+        {
+            levels.push_back(sqrt(pow(x[i]-46.5,2)+pow(y[i]-52.5,2)));
+            radiuses.push_back(2+levels.back()/4);
+        }
+        VIBES_TEST( vibes::drawPoints(x,y,levels,radiuses,vibesParams("ColorMap","jet")) );
+    }
     
 
     // Testing VIbes drawText function
@@ -318,6 +404,20 @@ int main()
     vibes::newFigure("test Raster");
     vibes::drawRaster(std::filesystem::current_path().string()+"/../VIBes.png", 10, 5, 10.,5.);
 
+    vibes::newFigure("test Heatmap");
+    {
+        // Gaussian bump, then updated in place with a shifted one
+        vector< vector<double> > data(100, vector<double>(150));
+        for (int i = 0; i < 100; ++i)
+            for (int j = 0; j < 150; ++j)
+                data[i][j] = exp(-(pow(j - 50., 2) + pow(i - 50., 2)) / 400.);
+        VIBES_TEST( vibes::drawHeatmap(data, 0., 15., 0., 10., vibesParams("ColorMap","jet","name","heatmap")) );
+        for (int i = 0; i < 100; ++i)
+            for (int j = 0; j < 150; ++j)
+                data[i][j] = exp(-(pow(j - 100., 2) + pow(i - 50., 2)) / 400.);
+        VIBES_TEST( vibes::setObjectProperty("heatmap", "data", data) );
+    }
+
     std::cout << "end drawing" << std::endl;
 
     // Not needed anymore: VIBES_TEST( vibes::endDrawing() );
@@ -26,6 +26,7 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cassert>
+#include <algorithm>
 #include <limits>
 #include <iomanip>
 #include <memory>
@@ -334,6 +335,22 @@ namespace vibes
       fflush(channel.get());
   }
 
+  void drawConfidenceEllipses(const vector<vector<double> > &centers, const vector<vector<double> > &covs,
+                              const double &K, Params params)
+  {
+      beginDrawingIfNeeded();
+      Params msg;
+      msg["action"] = "draw";
+      msg["figure"] = params.pop("figure",current_fig);
+      msg["shape"] = (params, "type", "ellipses",
+                              "centers", centers,
+                              "covariances", covs,
+                              "sigma", K);
+
+      fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+      fflush(channel.get());
+  }
+
   void drawSector(const double &cx, const double &cy, const double &a, const double &b,
                   const double &startAngle, const double &endAngle, Params params)
   {
@@ -375,6 +392,38 @@ namespace vibes
       fflush(channel.get());
   }
 
+  void drawPies(const std::vector<double> &cx, const std::vector<double> &cy,
+                const std::vector<double> &r_min, const std::vector<double> &r_max,
+                const std::vector<double> &theta_min, const std::vector<double> &theta_max, Params params)
+  {
+      beginDrawingIfNeeded();
+      // Reshape bounds into lists of centers, radius ranges and angular ranges
+      const std::size_t n = std::min(std::min(std::min(cx.size(), cy.size()), std::min(r_min.size(), r_max.size())),
+                                     std::min(theta_min.size(), theta_max.size()));
+      std::vector<Value> centers, rho, theta;
+      centers.reserve(n);
+      rho.reserve(n);
+      theta.reserve(n);
+      for (std::size_t i = 0; i < n; ++i) {
+          Vec2d cxy = { cx[i], cy[i] };
+          Vec2d rMinMax = { r_min[i], r_max[i] };
+          Vec2d thetaMinMax = { theta_min[i], theta_max[i] };
+          centers.push_back(cxy);
+          rho.push_back(rMinMax);
+          theta.push_back(thetaMinMax);
+      }
+      Params msg;
+      msg["action"] = "draw";
+      msg["figure"] = params.pop("figure",current_fig);
+      msg["shape"] = (params, "type", "pies",
+                              "centers", centers,
+                              "rho", rho,
+                              "theta", theta);
+
+      fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+      fflush(channel.get());
+  }
+
   void drawPoint(const double &cx, const double &cy, Params params)
   {
       beginDrawingIfNeeded();
@@ -429,6 +478,12 @@ namespace vibes
      fflush(channel.get());
   }
 
+  void drawBoxes(const std::vector<std::vector<double> > &bounds, const std::vector<double> &colorLevels, Params params)
+  {
+     params["ColorLevels"] = colorLevels;
+     drawBoxes(bounds, params);
+  }
+
   void drawBoxesUnion(const std::vector<std::vector<double> > &bounds, Params params)
   {
      beginDrawingIfNeeded();
@@ -479,29 +534,44 @@ namespace vibes
      fflush(channel.get());
   }
 
-  //void drawPoints(const std::vector<std::vector<double> > &points, Params params)
-  //{
-  //    Params msg;
-  //    msg["action"]="draws";
-  //    msg["figure"] = params.pop("figure",current_fig);
-  //    msg["shape"] = (params, "type", "points",
-  //                           "points", points);
-  //    fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
-  //    fflush(channel.get());
-  //}
-
-  //void drawPoints(const std::vector<std::vector<double> > &points,  const std::vector<double> &colorLevels, const std::vector<double> &radiuses, Params params)
-  //{
-  //    Params msg;
-  //    msg["action"]="draws";
-  //    msg["figure"] = params.pop("figure",current_fig);
-  //    msg["shape"] = (params, "type", "points",
-  //                           "points", points,
-  //                           "colorLevels", colorLevels,
-  //                           "radiuses", radiuses);
-  //    fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
-  //    fflush(channel.get());
-  //}
+  void drawPoints(const std::vector<std::vector<double> > &points, Params params)
+  {
+      beginDrawingIfNeeded();
+      Params msg;
+      msg["action"] = "draw";
+      msg["figure"] = params.pop("figure",current_fig);
+      msg["shape"] = (params, "type", "points",
+                              "centers", points);
+      fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+      fflush(channel.get());
+  }
+
+  void drawPoints(const std::vector<std::vector<double> > &points, const std::vector<double> &colorLevels, Params params)
+  {
+      beginDrawingIfNeeded();
+      Params msg;
+      msg["action"] = "draw";
+      msg["figure"] = params.pop("figure",current_fig);
+      msg["shape"] = (params, "type", "points",
+                              "centers", points,
+                              "ColorLevels", colorLevels);
+      fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+      fflush(channel.get());
+  }
+
+  void drawPoints(const std::vector<std::vector<double> > &points,  const std::vector<double> &colorLevels, const std::vector<double> &radiuses, Params params)
+  {
+      beginDrawingIfNeeded();
+      Params msg;
+      msg["action"] = "draw";
+      msg["figure"] = params.pop("figure",current_fig);
+      msg["shape"] = (params, "type", "points",
+                              "centers", points,
+                              "ColorLevels", colorLevels,
+                              "Radiuses", radiuses);
+      fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+      fflush(channel.get());
+  }
 
   void drawPoints(const std::vector<double> &x, const std::vector<double> &y, Params params)
   {
@@ -527,54 +597,18 @@ namespace vibes
      fflush(channel.get());
   }
 
-  //void drawPoints(const std::vector<double> &x, const std::vector<double> y, const std::vector<double> &colorLevels, Params params)
-  //{
-  //    // Reshape x and y into a vector of points
-  //   std::vector<Value> points;
-  //   std::vector<double>::const_iterator itx = x.begin();
-  //   std::vector<double>::const_iterator ity = y.begin();
-//   Vec2d vp;
-  //   while (itx != x.end() && ity != y.end()) {
-//    vp._data[0] = *itx++;
-//    vp._data[1] = *ity++;
-  //      points.push_back( vp );
-  //   }
-  //   // Send message
-  //   Params msg;
-  //   msg["action"] = "draw";
-  //   msg["figure"] = params.pop("figure",current_fig);
-  //   msg["shape"] = (params, "type", "points",
-  //                           "points", points,
-  //                           "colorLevels", colorLevels);
-//
-  //   fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
-  //   fflush(channel.get());
-  //}
-
-  //void drawPoints(const std::vector<double> &x, const std::vector<double> y, const std::vector<double> &colorLevels, const std::vector<double> &radiuses, Params params)
-  //{
-  //   // Reshape x and y into a vector of points
-  //   std::vector<Value> points;
-  //   std::vector<double>::const_iterator itx = x.begin();
-  //   std::vector<double>::const_iterator ity = y.begin();
-//   Vec2d vp;
-  //   while (itx != x.end() && ity != y.end()) {
-//    vp._data[0] = *itx++;
-//    vp._data[1] = *ity++;
-  //      points.push_back( vp );
-  //   }
-  //   // Send message
-  //   Params msg;
-  //   msg["action"] = "draw";
-  //   msg["figure"] = params.pop("figure",current_fig);
-  //   msg["shape"] = (params, "type", "points",
-  //                           "points", points,
-  //                           "colorLevels", colorLevels,
-  //                           "radiuses", radiuses);
-//
-  //   fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
-  //   fflush(channel.get());
-  //}
+  void drawPoints(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &colorLevels, Params params)
+  {
+     params["ColorLevels"] = colorLevels;
+     drawPoints(x, y, params);
+  }
+
+  void drawPoints(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &colorLevels, const std::vector<double> &radiuses, Params params)
+  {
+     params["ColorLevels"] = colorLevels;
+     params["Radiuses"] = radiuses;
+     drawPoints(x, y, params);
+  }
 
   void drawArrow(const double &xA, const double &yA, const double &xB, const double &yB, const double &tip_length, Params params)
   {
@@ -637,6 +671,63 @@ namespace vibes
     fflush(channel.get());
   }
 
+  void drawArrows(const std::vector<double> &x, const std::vector<double> &y,
+                  const std::vector<double> &vx, const std::vector<double> &vy,
+                  const double &tip_length, Params params)
+  {
+    beginDrawingIfNeeded();
+    // Reshape coordinates into lists of origins and vectors
+    const std::size_t n = std::min(std::min(x.size(), y.size()), std::min(vx.size(), vy.size()));
+    std::vector<Value> origins, vectors;
+    origins.reserve(n);
+    vectors.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        Vec2d vo = { x[i], y[i] };
+        Vec2d vv = { vx[i], vy[i] };
+        origins.push_back(vo);
+        vectors.push_back(vv);
+    }
+    // Send message
+    Params msg;
+    msg["action"] = "draw";
+    msg["figure"] = params.pop("figure",current_fig);
+    msg["shape"] = (params, "type", "arrows",
+                            "origins", origins,
+                            "vectors", vectors,
+                            "tip_length", tip_length);
+
+    fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+    fflush(channel.get());
+  }
+
+  void drawLines(const std::vector<double> &coords, const std::vector<int> &offsets, Params params)
+  {
+     beginDrawingIfNeeded();
+     Params msg;
+     msg["action"] = "draw";
+     msg["figure"] = params.pop("figure",current_fig);
+     msg["shape"] = (params, "type", "lines",
+                             "coordinates", coords,
+                             "offsets", offsets);
+
+     fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+     fflush(channel.get());
+  }
+
+  void drawPolygons(const std::vector<double> &coords, const std::vector<int> &offsets, Params params)
+  {
+     beginDrawingIfNeeded();
+     Params msg;
+     msg["action"] = "draw";
+     msg["figure"] = params.pop("figure",current_fig);
+     msg["shape"] = (params, "type", "polygons",
+                             "coordinates", coords,
+                             "offsets", offsets);
+
+     fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+     fflush(channel.get());
+  }
+
   void drawPolygon(const std::vector<double> &x, const std::vector<double> &y, Params params)
   {
     beginDrawingIfNeeded();
@@ -771,6 +862,23 @@ namespace vibes
     fflush(channel.get());
   }
 
+  void drawHeatmap(const std::vector<std::vector<double> > &data, const double &xlb, const double &xub,
+                   const double &ylb, const double &yub, Params params)
+  {
+    beginDrawingIfNeeded();
+    Vec4d bounds = { xlb, xub, ylb, yub };
+
+    Params msg;
+    msg["action"] = "draw";
+    msg["figure"] = params.pop("figure",current_fig);
+    msg["shape"] = (params, "type", "heatmap",
+                            "data", data,
+                            "bounds", bounds);
+
+    fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+    fflush(channel.get());
+  }
+
   void drawCake(const double &cx, const double &cy, const double &rot, const double &length, Params params)
   {
       beginDrawingIfNeeded();
@@ -837,6 +945,23 @@ namespace vibes
      removeObject(current_fig, objectName);
   }
 
+  void removeObjects(const std::string &figureName, const Params &selector)
+  {
+     beginDrawingIfNeeded();
+     Params msg;
+     msg["action"] = "delete";
+     msg["figure"] = figureName;
+     msg["selector"] = selector;
+
+     fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+     fflush(channel.get());
+  }
+
+  void removeObjects(const Params &selector)
+  {
+     removeObjects(current_fig, selector);
+  }
+
   // Property modification
   void setFigureProperties(const std::string &figureName, const Params &properties)
   {
@@ -875,4 +1000,75 @@ namespace vibes
   {
      setObjectProperties(current_fig, objectName, properties);
   }
+
+  void setObjectsProperties(const std::string &figureName, const Params &selector, const Params &properties)
+  {
+     beginDrawingIfNeeded();
+     // Send message
+     Params msg;
+     msg["action"] = "set";
+     msg["figure"] = figureName;
+     msg["selector"] = selector;
+     msg["properties"] = properties;
+
+     fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+     fflush(channel.get());
+  }
+
+  void setObjectsProperties(const Params &selector, const Params &properties)
+  {
+     setObjectsProperties(current_fig, selector, properties);
+  }
+
+  // Pose update
+  void setPose(const std::string &figureName, const std::string &objectName, const double &x, const double &y, const double &heading)
+  {
+     beginDrawingIfNeeded();
+     Vec<double,3> pose = {{x, y, heading}};
+     // Send message
+     Params msg;
+     msg["action"] = "pose";
+     msg["figure"] = figureName;
+     msg["object"] = objectName;
+     msg["pose"] = pose;
+
+     fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+     fflush(channel.get());
+  }
+
+  void setPose(const std::string &objectName, const double &x, const double &y, const double &heading)
+  {
+     setPose(current_fig, objectName, x, y, heading);
+  }
+
+  void setPoses(const std::string &figureName, const std::vector<std::string> &objectNames,
+                const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &heading)
+  {
+     beginDrawingIfNeeded();
+     // One [x, y, heading] array per object
+     std::vector<Value> poses;
+     Vec<double,3> pose;
+     for (size_t i = 0; i < objectNames.size() && i < x.size() && i < y.size() && i < heading.size(); ++i)
+     {
+        pose._data[0] = x[i];
+        pose._data[1] = y[i];
+        pose._data[2] = heading[i];
+        poses.push_back(pose);
+     }
+     // Send message
+     Params msg;
+     msg["action"] = "pose";
+     msg["figure"] = figureName;
+     msg["objects"] = std::vector<Value>(objectNames.begin(), objectNames.begin() + poses.size());
+     msg["poses"] = poses;
+
+     fputs(Value(msg).toJSONString().append("\n\n").c_str(), channel.get());
+     fflush(channel.get());
+  }
+
+  void setPoses(const std::vector<std::string> &objectNames,
+                const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &heading)
+  {
+     setPoses(current_fig, objectNames, x, y, heading);
+  }
 }
\ No newline at end of file
@@ -314,11 +314,18 @@ namespace vibes {
   VIBES_FUNC_COLOR_PARAM_3(drawConfidenceEllipse,const std::vector<double> &,center,
                                                  const std::vector<double> &,cov,
                                                  const double &,K/*=3.0*/)
+  /// Draw a set of N-D confidence ellipses, centered at \a centers, with the covariances in \a covs (each one
+  /// flattened like \a cov above) and scale \a K, sent as a single shape
+  VIBES_FUNC_COLOR_PARAM_3(drawConfidenceEllipses,const std::vector< std::vector<double> > &,centers,
+                                                  const std::vector< std::vector<double> > &,covs,
+                                                  const double &,K)
   /// Draw a circle centered at (\a cx, \a cy), with radius \a r
   VIBES_FUNC_COLOR_PARAM_3(drawCircle,const double &,cx, const double &,cy, const double &,r)
 
   /// Draw a list of N-D rectangles from a list of list of \a bounds in the form ((x_lb_1, x_ub_1, y_lb_1, ...), (x_lb_2, x_ub_2, y_lb_2, ...), ...)
   VIBES_FUNC_COLOR_PARAM_1(drawBoxes,const std::vector< std::vector<double> > &,bounds)
+  /// Same, each box being filled with the color of its level in \a colorLevels (see the "ColorMap" and "ColorRange" parameters)
+  VIBES_FUNC_COLOR_PARAM_2(drawBoxes,const std::vector< std::vector<double> > &,bounds, const std::vector<double> &,colorLevels)
   /// Computes and draw the union of a list of N-D rectangles, from a list of list of \a bounds in the form ((x_lb_1, x_ub_1, y_lb_1, ...), (x_lb_2, x_ub_2, y_lb_2, ...), ...)
   VIBES_FUNC_COLOR_PARAM_1(drawBoxesUnion,const std::vector< std::vector<double> > &,bounds)
 
@@ -326,14 +333,22 @@ namespace vibes {
   VIBES_FUNC_COLOR_PARAM_1(drawLine,const std::vector< std::vector<double> > &,points)
   /// Draw a 2-D line from the list of abscissae \a x and the list of ordinates \a y
   VIBES_FUNC_COLOR_PARAM_2(drawLine,const std::vector<double> &,x, const std::vector<double> &,y)
-
-  // Draw a N-D set of points
-  //VIBES_FUNC_COLOR_PARAM_1(drawPoints,const std::vector< std::vector<double> > &,points)
-  //VIBES_FUNC_COLOR_PARAM_2(drawPoints,const std::vector< std::vector<double> > &,points, const std::vector<double> &,colorLevels)
-  //VIBES_FUNC_COLOR_PARAM_3(drawPoints,const std::vector< std::vector<double> > &,points, const std::vector<double> &,colorLevels, const std::vector<double>&,radiuses)
+  /// Draw a set of 2-D lines, sent as a single shape: the points of line i are (coords[2k], coords[2k+1])
+  /// for k in [offsets[i], offsets[i+1]) (\a offsets has one more element than the number of lines)
+  VIBES_FUNC_COLOR_PARAM_2(drawLines,const std::vector<double> &,coords, const std::vector<int> &,offsets)
+
+  /// Draw a N-D set of points, from the list of coordinates \a points in the form ((x_1, y_1, z_1, ...), (x_2, y_2, z_2, ...), ...)
+  VIBES_FUNC_COLOR_PARAM_1(drawPoints,const std::vector< std::vector<double> > &,points)
+  /// Same, each point being colored from its level in \a colorLevels (see the "ColorMap" and "ColorRange" parameters)
+  VIBES_FUNC_COLOR_PARAM_2(drawPoints,const std::vector< std::vector<double> > &,points, const std::vector<double> &,colorLevels)
+  /// Same, each point having its own radius in \a radiuses
+  VIBES_FUNC_COLOR_PARAM_3(drawPoints,const std::vector< std::vector<double> > &,points, const std::vector<double> &,colorLevels, const std::vector<double>&,radiuses)
+  /// Draw a 2-D set of points, from the list of abscissae \a x and the list of ordinates \a y
   VIBES_FUNC_COLOR_PARAM_2(drawPoints,const std::vector<double> &,x, const std::vector<double> &,y)
-  //VIBES_FUNC_COLOR_PARAM_3(drawPoints,const std::vector<double> &,x, const std::vector<double> &,y, const std::vector<double> &,colorLevels)
-  //VIBES_FUNC_COLOR_PARAM_4(drawPoints,const std::vector<double> &,x, const std::vector<double> &,y, const std::vector<double> &,colorLevels, const std::vector<double>&,radiuses)
+  /// Same, each point being colored from its level in \a colorLevels
+  VIBES_FUNC_COLOR_PARAM_3(drawPoints,const std::vector<double> &,x, const std::vector<double> &,y, const std::vector<double> &,colorLevels)
+  /// Same, each point having its own radius in \a radiuses
+  VIBES_FUNC_COLOR_PARAM_4(drawPoints,const std::vector<double> &,x, const std::vector<double> &,y, const std::vector<double> &,colorLevels, const std::vector<double>&,radiuses)
 
   /// Draw a 2-D arrow from (xA,yA) to (xB,yB)
   VIBES_FUNC_COLOR_PARAM_5(drawArrow,const double &,xA, const double &,yA, const double &,xB, const double &,yB, const double &,tip_length)
@@ -341,9 +356,14 @@ namespace vibes {
   VIBES_FUNC_COLOR_PARAM_2(drawArrow,const std::vector< std::vector<double> > &,points, const double &,tip_length)
   /// Draw a 2-D arrow from the list of abscissae \a x and the list of ordinates \a y
   VIBES_FUNC_COLOR_PARAM_3(drawArrow,const std::vector<double> &,x, const std::vector<double> &,y, const double &,tip_length)
+  /// Draw a field of 2-D arrows, from the origins (\a x, \a y) along the vectors (\a vx, \a vy), sent as a single shape.
+  /// If \a tip_length is zero, tips are proportional to the arrows. Use the "ColorMap" parameter to color them by magnitude.
+  VIBES_FUNC_COLOR_PARAM_5(drawArrows,const std::vector<double> &,x, const std::vector<double> &,y, const std::vector<double> &,vx, const std::vector<double> &,vy, const double &,tip_length)
 
   /// Draw a 2-D polygon from the list of abscissae \a x and the list of ordinates \a y
   VIBES_FUNC_COLOR_PARAM_2(drawPolygon,const std::vector<double> &,x, const std::vector<double> &,y)
+  /// Draw a set of 2-D polygons, sent as a single shape, from flat coordinates and offsets as in drawLines
+  VIBES_FUNC_COLOR_PARAM_2(drawPolygons,const std::vector<double> &,coords, const std::vector<int> &,offsets)
 
   /// Draw a text <text> at position <cx, cy>
   VIBES_FUNC_COLOR_PARAM_3(drawText, const double&, top_left_x, const double&, top_left_y,
@@ -376,6 +396,12 @@ namespace vibes {
                                        const double &,r_min, const double &,r_max,
                                        const double &,theta_min, const double &,theta_max)
 
+  /// Draw a set of pies, the i-th one at position (cx[i], cy[i]) with radius between (r_min[i], r_max[i]) and
+  /// angular bounds (theta_min[i], theta_max[i]), sent as a single shape (angles in degrees and counterclockwise)
+  VIBES_FUNC_COLOR_PARAM_6(drawPies, const std::vector<double> &,cx, const std::vector<double> &,cy,
+                                     const std::vector<double> &,r_min, const std::vector<double> &,r_max,
+                                     const std::vector<double> &,theta_min, const std::vector<double> &,theta_max)
+
   /// Draw a Point at position (cy, cy)
   VIBES_FUNC_COLOR_PARAM_2(drawPoint, const double &,cx, const double &,cy)
 
@@ -386,6 +412,13 @@ namespace vibes {
   VIBES_FUNC_COLOR_PARAM_4(drawRing, const double &,cx, const double &,cy,
                                      const double &,r_min, const double &,r_max)
 
+  /// Draw a heatmap of the matrix \a data (rows of values, the first one at the top) over the box
+  /// [xlb, xub] x [ylb, yub], colored through the "ColorMap" parameter ("viridis", "jet", "hot", "gray" or a
+  /// list of colors) and "ColorRange". Setting its "data" property later updates the image in place.
+  VIBES_FUNC_COLOR_PARAM_5(drawHeatmap, const std::vector< std::vector<double> > &,data,
+                                        const double &,xlb, const double &,xub,
+                                        const double &,ylb, const double &,yub)
+
   /// Draw a raster image with upper left corner at position <ulb, yub>
   /// and with <width, height> size. Possibly with a rotation <rot> in degrees.
   /// The color used for transparency is throw the pen color
@@ -416,6 +449,13 @@ namespace vibes {
   /// Delete the named graphical object \a objectName from current figure.
   void removeObject(const std::string &objectName);
 
+  /// Delete every graphical object of figure \a figureName matching \a selector.
+  /// The selector combines "name" (name or glob pattern such as "robot*"), "group" (objects in a named group)
+  /// and "type" (shape type), e.g. vibesParams("group","agents","type","vehicle").
+  void removeObjects(const std::string &figureName, const Params &selector);
+  /// Delete every graphical object of current figure matching \a selector.
+  void removeObjects(const Params &selector);
+
   /// @}
   /// @name Object properties modification
   /// @{
@@ -430,6 +470,28 @@ namespace vibes {
   /// Assign \a properties to the named object \a objectName in current figure.
   void setObjectProperties(const std::string &objectName, const Params &properties);
 
+  /// Assign \a properties to every object of figure \a figureName matching \a selector (see removeObjects).
+  void setObjectsProperties(const std::string &figureName, const Params &selector, const Params &properties);
+  /// Assign \a properties to every object of current figure matching \a selector (see removeObjects).
+  void setObjectsProperties(const Params &selector, const Params &properties);
+
+  /// @}
+  /// @name Objects pose
+  /// @{
+
+  /// Move the named object \a objectName of figure \a figureName to (\a x,\a y) with heading \a heading (degrees).
+  /// The object is not redrawn: its pose replaces its center and orientation (e.g. for vehicles).
+  void setPose(const std::string &figureName, const std::string &objectName, const double &x, const double &y, const double &heading);
+  /// Move the named object \a objectName of current figure to (\a x,\a y) with heading \a heading (degrees).
+  void setPose(const std::string &objectName, const double &x, const double &y, const double &heading);
+
+  /// Move several named objects of figure \a figureName at once (one message for all the poses).
+  void setPoses(const std::string &figureName, const std::vector<std::string> &objectNames,
+                const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &heading);
+  /// Move several named objects of current figure at once (one message for all the poses).
+  void setPoses(const std::vector<std::string> &objectNames,
+                const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &heading);
+
   /// @}
   ///
   ///
@@ -0,0 +1,154 @@
+#include "axisoverlay.h"
+
+#include <QGraphicsView>
+#include <QPainter>
+#include <QFontMetricsF>
+
+#include <cmath>
+
+AxisOverlay::AxisOverlay(QGraphicsView *view) :
+    QWidget(view),
+    _view(view),
+    _fontSize(11),
+    _xTicksSpacing(50),
+    _yTicksSpacing(35),
+    _dirty(true)
+{
+    // Mouse events go to the view below
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setAttribute(Qt::WA_NoSystemBackground);
+    setFocusPolicy(Qt::NoFocus);
+    fitViewport();
+}
+
+void AxisOverlay::setFontSize(int size)
+{
+    _fontSize = qBound(1, size, 512);
+    _dirty = true;
+    update();
+}
+
+void AxisOverlay::setXTicksSpacing(int spacing)
+{
+    _xTicksSpacing = qBound(1, spacing, 512);
+    _dirty = true;
+    update();
+}
+
+void AxisOverlay::setYTicksSpacing(int spacing)
+{
+    _yTicksSpacing = qBound(1, spacing, 512);
+    _dirty = true;
+    update();
+}
+
+void AxisOverlay::resetSettings()
+{
+    _fontSize = 11;
+    _xTicksSpacing = 50;
+    _yTicksSpacing = 35;
+    _dirty = true;
+    update();
+}
+
+void AxisOverlay::fitViewport()
+{
+    setGeometry(_view->viewport()->geometry());
+}
+
+void AxisOverlay::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    paintAxes(&painter);
+}
+
+void AxisOverlay::paintAxes(QPainter *painter)
+{
+    // Ticks only depend on the view transform, viewport size and settings
+    if (_dirty || _transform != _view->viewportTransform() || _viewportSize != _view->viewport()->size())
+        computeTicks();
+
+    painter->save();
+    painter->setPen(QColor(0,0,0));
+    painter->setBrush(Qt::NoBrush);
+    painter->setFont(_font);
+    painter->drawLines(_tickLines);
+    foreach (const Tick &tick, _ticks)
+        painter->drawStaticText(tick.labelPos, tick.label);
+    painter->restore();
+}
+
+QString AxisOverlay::tickText(double value)
+{
+    QString text;
+    if (fabs(value) < 1.0e-12)
+        text.setNum(value, 'f', 0);
+    else
+        text.setNum(value, 'g');
+    return text;
+}
+
+void AxisOverlay::computeTicks()
+{
+    _dirty = false;
+    _transform = _view->viewportTransform();
+    _viewportSize = _view->viewport()->size();
+    _tickLines.clear();
+    _ticks.clear();
+
+    _font = QFont("Helvetica", _fontSize);
+    _font.setStyleHint(QFont::Helvetica);
+    // Labels are placed by their top-left corner, offset so the baseline is at fontSize+3
+    const double labelTop = _fontSize + 3 - QFontMetricsF(_font).ascent();
+
+    const QRectF rect = _view->mapToScene(_view->viewport()->rect()).boundingRect();
+    if (rect.isEmpty())
+        return;
+
+    // Min spacing between ticks (divisor is min spacing in px)
+    double nb_ticks_x = _viewportSize.width() / (double)_xTicksSpacing;
+    double nb_ticks_y = _viewportSize.height() / (double)_yTicksSpacing;
+
+    int log_scale_x = ceil(log10(rect.width()/nb_ticks_x)*3.0);
+    double scale_x = pow(10.0, floor((double)log_scale_x/3));
+    switch (log_scale_x%3) {
+    case 0: break;
+    case 1: case-2: scale_x *= 2.0; break;
+    case 2: case-1: scale_x *= 5.0; break;
+    }
+
+    int log_scale_y = ceil(log10(rect.height()/nb_ticks_y)*3.0);
+    double scale_y = pow(10.0, floor((double)log_scale_y/3));
+    switch (log_scale_y%3) {
+    case 0: break;
+    case 1: case-2: scale_y *= 2.0; break;
+    case 2: case-1: scale_y *= 5.0; break;
+    }
+
+    double x0 = ceil(rect.left() / scale_x) * scale_x;
+    double y0 = ceil(qMin(rect.bottom(),rect.top()) / scale_y) * scale_y;
+
+    for (double xtick=x0; xtick<qMax(rect.right(), rect.left()); xtick+=scale_x)
+    {
+        double x_wnd = _transform.map(QPointF(xtick,0)).x();
+        _tickLines << QLineF(x_wnd,0,x_wnd,5);
+        Tick tick;
+        tick.labelPos = QPointF(x_wnd+3, labelTop);
+        tick.label = QStaticText(tickText(xtick));
+        tick.label.setTextFormat(Qt::PlainText);
+        tick.label.prepare(QTransform(), _font);
+        _ticks << tick;
+    }
+
+    for (double ytick=y0; ytick<qMax(rect.top(),rect.bottom()); ytick+=scale_y)
+    {
+        double y_wnd = _transform.map(QPointF(0,ytick)).y();
+        _tickLines << QLineF(0,y_wnd,5,y_wnd);
+        Tick tick;
+        tick.labelPos = QPointF(3, y_wnd+labelTop);
+        tick.label = QStaticText(tickText(ytick));
+        tick.label.setTextFormat(Qt::PlainText);
+        tick.label.prepare(QTransform(), _font);
+        _ticks << tick;
+    }
+}
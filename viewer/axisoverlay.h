@@ -0,0 +1,71 @@
+#ifndef AXISOVERLAY_H
+#define AXISOVERLAY_H
+
+#include <QWidget>
+#include <QFont>
+#include <QLineF>
+#include <QSize>
+#include <QStaticText>
+#include <QTransform>
+#include <QVector>
+
+class QGraphicsView;
+class QPainter;
+
+/// Transparent widget drawing the axis ticks and labels on top of the viewport of a view.
+///
+/// Ticks and their labels (as QStaticText) are computed only when the view transform,
+/// the viewport size or the tick settings change. Repaints of the scene below only
+/// blit the cached labels, so the view does not need full viewport updates.
+
+class AxisOverlay : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit AxisOverlay(QGraphicsView *view);
+
+    int fontSize() const { return _fontSize; }
+    int xTicksSpacing() const { return _xTicksSpacing; }
+    int yTicksSpacing() const { return _yTicksSpacing; }
+
+    void setFontSize(int size);
+    void setXTicksSpacing(int spacing);
+    void setYTicksSpacing(int spacing);
+    /// Back to default font size and ticks spacing
+    void resetSettings();
+    /// Draws the ticks and labels in viewport coordinates (used by paintEvent and exports)
+    void paintAxes(QPainter *painter);
+
+public slots:
+    /// Covers the viewport of the view (to be called when the view is resized)
+    void fitViewport();
+
+protected:
+    void paintEvent(QPaintEvent *event);
+
+private:
+    struct Tick
+    {
+        QPointF labelPos;
+        QStaticText label;
+    };
+
+    void computeTicks();
+    static QString tickText(double value);
+
+    QGraphicsView *_view;
+    int _fontSize;
+    int _xTicksSpacing;
+    int _yTicksSpacing;
+
+    QFont _font;
+    QVector<QLineF> _tickLines;
+    QVector<Tick> _ticks;
+
+    // State the ticks were computed for
+    bool _dirty;
+    QTransform _transform;
+    QSize _viewportSize;
+};
+
+#endif // AXISOVERLAY_H
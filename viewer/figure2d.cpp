@@ -4,8 +4,11 @@
 #include <QFileDialog>
 #include <QSvgGenerator>
 #include <QScrollBar>
+#include <QTimer>
 
 #include "vibesscene2d.h"
+#include "tilerenderer.h"
+#include "axisoverlay.h"
 #include <QtGui>
 #include <QComboBox>
 #include <QLabel>
@@ -15,20 +18,28 @@ Figure2D::Figure2D(QWidget *parent) :
     QGraphicsView(parent),
     lbProjX(new QLabel("xlabelhere",this)),
     lbProjY(new QLabel("ylabelhere",this)),
-    showAxis(true),
-    fontSize(11),
-    xTicksSpacing(50),
-    yTicksSpacing(35)
+    axisOverlay(new AxisOverlay(this)),
+    tileRenderer(0),
+    progressiveRendering(false),
+    progressiveSliceTime(15),
+    progressiveTimer(new QTimer(this)),
+    adaptiveQuality(true),
+    interacting(false),
+    idleTimer(new QTimer(this)),
+    maxFps(0),
+    unthrottledUpdateMode(BoundingRectViewportUpdate),
+    frameTimer(new QTimer(this))
 {
     setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
 
     // Create a new scene
     setScene(new VibesScene2D(this));
     this->scale(1.0, -1.0);
+    notifyZoom();
     this->show();
     setDragMode(ScrollHandDrag);
-    // Force full viewport update (avoid problems with axes)
-    setViewportUpdateMode(FullViewportUpdate);
+    // Axes are drawn by an overlay: only repaint the changed part of the scene
+    setViewportUpdateMode(BoundingRectViewportUpdate);
     // Never show the scrollbars
     setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
     setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
@@ -48,6 +59,11 @@ Figure2D::Figure2D(QWidget *parent) :
     lbProjY->installEventFilter(this);
     lbProjY->show();
 
+    // Projection selectors stay above the axes
+    axisOverlay->show();
+    lbProjX->raise();
+    lbProjY->raise();
+
     cbProjX = new QComboBox(lbProjX);
     cbProjX->setMaximumSize(lbProjX->size());
     connect(cbProjX, SIGNAL(currentTextChanged(QString)), lbProjX, SLOT(setText(QString)));
@@ -71,6 +87,175 @@ Figure2D::Figure2D(QWidget *parent) :
     connect(scene(), SIGNAL(changedDimY(int)), cbProjY, SLOT(setCurrentIndex(int)));
 
     connect(scene(), SIGNAL(dimensionsChanged()), this, SLOT(refreshProjectionSelectors()));
+
+    // Full quality frame once pan/zoom input has been idle for a while
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(200);
+    connect(idleTimer, SIGNAL(timeout()), this, SLOT(endInteraction()));
+
+    // Progressive rendering: next slice as soon as pending events are processed
+    progressiveTimer->setSingleShot(true);
+    progressiveTimer->setInterval(0);
+    connect(progressiveTimer, SIGNAL(timeout()), this, SLOT(renderPendingTiles()));
+
+    // Repaint throttling, disabled until a frame rate is set
+    frameTimer->setSingleShot(true);
+    connect(frameTimer, SIGNAL(timeout()), this, SLOT(flushUpdate()));
+    lastFrame.start();
+}
+
+Figure2D::~Figure2D()
+{
+    delete tileRenderer;
+}
+
+void Figure2D::setTiledRendering(bool enabled)
+{
+    if (enabled == tiledRendering())
+        return;
+    if (enabled)
+    {
+        tileRenderer = new TileRenderer(this);
+        tileRenderer->setProgressive(progressiveRendering);
+        // Only listen to scene changes when needed: this disables some QGraphicsView update optimizations
+        connect(scene(), SIGNAL(changed(QList<QRectF>)), this, SLOT(invalidateTiles(QList<QRectF>)));
+    }
+    else
+    {
+        disconnect(scene(), SIGNAL(changed(QList<QRectF>)), this, SLOT(invalidateTiles(QList<QRectF>)));
+        progressiveTimer->stop();
+        delete tileRenderer;
+        tileRenderer = 0;
+    }
+    viewport()->update();
+}
+
+void Figure2D::setProgressiveRendering(bool enabled)
+{
+    progressiveRendering = enabled;
+    // Progressive rendering works on tiles
+    if (enabled)
+        setTiledRendering(true);
+    if (tileRenderer)
+        tileRenderer->setProgressive(enabled);
+    viewport()->update();
+}
+
+void Figure2D::setProgressiveSliceTime(int msec)
+{
+    progressiveSliceTime = qMax(1, msec);
+}
+
+void Figure2D::renderPendingTiles()
+{
+    if (!tileRenderer)
+        return;
+    // Render a slice, then go back to the event loop (message reading, input) before the next one
+    tileRenderer->renderPending(progressiveSliceTime);
+    viewport()->update();
+}
+
+void Figure2D::invalidateTiles(const QList<QRectF> &region)
+{
+    if (tileRenderer)
+        tileRenderer->invalidate(region);
+}
+
+void Figure2D::setShowAxis(bool value)
+{
+    axisOverlay->setVisible(value);
+}
+
+void Figure2D::setAdaptiveQuality(bool enabled)
+{
+    if (!enabled)
+        endInteraction();
+    adaptiveQuality = enabled;
+}
+
+void Figure2D::setInteractionIdleDelay(int msec)
+{
+    idleTimer->setInterval(qMax(0, msec));
+}
+
+void Figure2D::setMaxFps(int fps)
+{
+    fps = qMax(0, fps);
+    if (fps == maxFps)
+        return;
+    if (maxFps == 0)
+    {
+        // Scene changes no longer update the viewport directly, they are accumulated
+        unthrottledUpdateMode = viewportUpdateMode();
+        setViewportUpdateMode(NoViewportUpdate);
+        connect(scene(), SIGNAL(changed(QList<QRectF>)), this, SLOT(accumulateUpdate(QList<QRectF>)));
+    }
+    else if (fps == 0)
+    {
+        // Unthrottled: back to direct updates, in the mode configured before throttling
+        disconnect(scene(), SIGNAL(changed(QList<QRectF>)), this, SLOT(accumulateUpdate(QList<QRectF>)));
+        setViewportUpdateMode(unthrottledUpdateMode);
+        flushUpdate();
+    }
+    maxFps = fps;
+}
+
+void Figure2D::accumulateUpdate(const QList<QRectF> &region)
+{
+    foreach (const QRectF &rect, region)
+        pendingUpdate |= rect;
+    if (frameTimer->isActive())
+        return;
+    // Repaint now if the last frame is old enough, otherwise wait for the end of the frame period
+    const int framePeriod = 1000 / maxFps;
+    frameTimer->start(qMax(0, framePeriod - int(lastFrame.elapsed())));
+}
+
+void Figure2D::flushUpdate()
+{
+    frameTimer->stop();
+    if (!pendingUpdate.isNull())
+    {
+        // Cosmetic pens are not in the item bounds: one pixel wide, plus one pixel for
+        // antialiasing (same margins as QGraphicsView)
+        const int margin = optimizationFlags().testFlag(DontAdjustForAntialiasing) ? 1 : 2;
+        viewport()->update(mapFromScene(pendingUpdate).boundingRect().adjusted(-margin, -margin, margin, margin));
+    }
+    pendingUpdate = QRectF();
+    lastFrame.restart();
+}
+
+void Figure2D::beginInteraction()
+{
+    if (!adaptiveQuality)
+        return;
+    if (!interacting)
+    {
+        interacting = true;
+        // Draft rendering: no antialiasing, items use a cheaper level of detail
+        fullQualityHints = renderHints();
+        setRenderHint(QPainter::Antialiasing, false);
+        setRenderHint(QPainter::SmoothPixmapTransform, false);
+        setOptimizationFlag(DontAdjustForAntialiasing, true);
+        scene()->setDraft(true);
+    }
+    // Restart the idle delay
+    idleTimer->start();
+}
+
+void Figure2D::endInteraction()
+{
+    idleTimer->stop();
+    if (!interacting)
+        return;
+    interacting = false;
+    setRenderHints(fullQualityHints);
+    setOptimizationFlag(DontAdjustForAntialiasing, false);
+    scene()->setDraft(false);
+    // Tiles rendered during the interaction are draft quality
+    if (tileRenderer)
+        tileRenderer->invalidate();
+    viewport()->update();
 }
 
 bool Figure2D::eventFilter(QObject *obj, QEvent *event)
@@ -117,8 +302,17 @@ void Figure2D::refreshProjectionSelectors()
     /// \todo Remove unused dimensions
 }
 
+void Figure2D::mousePressEvent(QMouseEvent *event)
+{
+    // Start of a drag
+    beginInteraction();
+    QGraphicsView::mousePressEvent(event);
+}
+
 void Figure2D::mouseMoveEvent(QMouseEvent * event)
 {
+    if (event->buttons() != Qt::NoButton)
+        beginInteraction();
     if (cbProjX->isVisible())
     {
         cbProjX->hide();
@@ -135,77 +329,41 @@ void Figure2D::mouseMoveEvent(QMouseEvent * event)
 }
 
 
-void Figure2D::drawForeground(QPainter *painter, const QRectF &rect)
+void Figure2D::notifyZoom()
 {
-    // if axis is disable
-    if (!showAxis) return;
-    // Black pen and empty brush for drawing axis
-    painter->setPen(QPen(Qt::black, 0));//, Qt::DashDotLine, Qt::RoundCap, Qt::RoundJoin));
-    painter->setBrush(Qt::NoBrush);
-
-    // Draw figure border frame (if bounds are specifier)
-    //painter->drawRect(this->sceneRect());
-
-    // Min spacing between ticks (divisor is min spacing in px)
-    double nb_ticks_x = this->viewport()->width() / (double)xTicksSpacing;
-    double nb_ticks_y = this->viewport()->height() / (double)yTicksSpacing;
-
-    int log_scale_x = ceil(log10(rect.width()/nb_ticks_x)*3.0);
-    double scale_x = pow(10.0, floor((double)log_scale_x/3));
-    switch (log_scale_x%3) {
-    case 0: break;
-    case 1: case-2: scale_x *= 2.0; break;
-    case 2: case-1: scale_x *= 5.0; break;
-    }
-
-    int log_scale_y = ceil(log10(rect.height()/nb_ticks_y)*3.0);
-    double scale_y = pow(10.0, floor((double)log_scale_y/3));
-    switch (log_scale_y%3) {
-    case 0: break;
-    case 1: case-2: scale_y *= 2.0; break;
-    case 2: case-1: scale_y *= 5.0; break;
-    }
-
-    double x0 = ceil(rect.left() / scale_x) * scale_x;
-    double y0 = ceil(qMin(rect.bottom(),rect.top()) / scale_y) * scale_y;
-
-    painter->setTransform(QTransform());
-    painter->setWindow(this->viewport()->rect());
-
-    QFont axisTicksFont("Helvetica", fontSize);
-    axisTicksFont.setStyleHint(QFont::Helvetica);
-    painter->setFont(axisTicksFont);
-    painter->setPen(QColor(0,0,0));
+    // Translations do not change the size of items drawn in pixels
+    const QTransform zoom(transform().m11(), transform().m12(), transform().m21(), transform().m22(), 0., 0.);
+    if (zoom == notifiedZoom)
+        return;
+    notifiedZoom = zoom;
+    scene()->viewZoomChanged();
+}
 
-        for (double xtick=x0; xtick<qMax(rect.right(), rect.left()); xtick+=scale_x)
+void Figure2D::paintEvent(QPaintEvent *event)
+{
+    if (!tileRenderer)
     {
-        double x_wnd = mapFromScene(xtick,0).x();
-
-        painter->drawLine(x_wnd,0,x_wnd,5);
-        QString xtick_txt;
-        if(fabs(xtick) < 1.0e-12)
-            xtick_txt.setNum(xtick, 'f', 0);
-        else
-            xtick_txt.setNum(xtick, 'g');
-        painter->drawText(x_wnd+3,fontSize+3, xtick_txt);
+        QGraphicsView::paintEvent(event);
+        return;
     }
 
-    for (double ytick=y0; ytick<qMax(rect.top(),rect.bottom()); ytick+=scale_y)
-    {
-        double y_wnd = mapFromScene(0,ytick).y();
-
-        painter->drawLine(0,y_wnd,5,y_wnd);
-        QString ytick_txt;
-        if(fabs(ytick) < 1.0e-12)
-            ytick_txt.setNum(ytick, 'f', 0);
-        else
-            ytick_txt.setNum(ytick, 'g');
-        painter->drawText(3, y_wnd+fontSize+3, ytick_txt);
-    }
+    QPainter painter(viewport());
+    // Background and foreground hooks work in scene coordinates, as in QGraphicsView::paintEvent
+    const QRectF exposedScene = mapToScene(event->rect()).boundingRect();
+    painter.setWorldTransform(viewportTransform());
+    drawBackground(&painter, exposedScene);
+    painter.resetTransform();
+    tileRenderer->paint(&painter, event->rect());
+    painter.setWorldTransform(viewportTransform());
+    drawForeground(&painter, exposedScene);
+    // Tiles left to render in progressive mode (restarted on each paint, so view changes abort the previous frame)
+    if (tileRenderer->hasPendingTiles() && !progressiveTimer->isActive())
+        progressiveTimer->start();
 }
 
 void Figure2D::wheelEvent(QWheelEvent *event)
 {
+    beginInteraction();
     if (event->modifiers().testFlag(Qt::ControlModifier))
     {
         QGraphicsView::wheelEvent(event);
@@ -225,6 +383,7 @@ void Figure2D::wheelEvent(QWheelEvent *event)
         if (event->modifiers().testFlag(Qt::ShiftModifier))
             sy = 1.0;
         this->scale(sx,sy);
+        notifyZoom();
 //        double dx = sceneRect().width() * (s - 1.0);
 //        double dy = sceneRect().height() * (s - 1.0);
 //        this->setSceneRect(sceneRect().adjusted(-dx,-dy,dx,dy));
@@ -238,50 +397,47 @@ void Figure2D::keyPressEvent(QKeyEvent *event)
     switch(event->key())
     {
     case Qt::Key_A:
-      this->showAxis = !this->showAxis;
-      this->scene()->update();
-      break;
+        axisOverlay->setVisible(axisOverlay->isHidden());
+        break;
     case Qt::Key_Plus:
     case Qt::Key_Q:
+        beginInteraction();
         this->scale(1.25,1.25);
+        notifyZoom();
         break;
     case Qt::Key_Minus:
     case Qt::Key_W:
+        beginInteraction();
         this->scale(0.8,0.8);
+        notifyZoom();
         break;
     case Qt::Key_X:
-        this->xTicksSpacing = this->xTicksSpacing < 512? this->xTicksSpacing+1: 512;
-        this->scene()->update();
+        axisOverlay->setXTicksSpacing(axisOverlay->xTicksSpacing()+1);
         break;
     case Qt::Key_S:
-        this->xTicksSpacing = this->xTicksSpacing > 1? this->xTicksSpacing-1: 1;
-        this->scene()->update();
+        axisOverlay->setXTicksSpacing(axisOverlay->xTicksSpacing()-1);
         break;
     case Qt::Key_Y:
-        this->yTicksSpacing = this->yTicksSpacing < 512? this->yTicksSpacing+1: 512;
-        this->scene()->update();
+        axisOverlay->setYTicksSpacing(axisOverlay->yTicksSpacing()+1);
         break;
     case Qt::Key_H:
-        this->yTicksSpacing = this->yTicksSpacing > 1? this->yTicksSpacing-1: 1;
-        this->scene()->update();
+        axisOverlay->setYTicksSpacing(axisOverlay->yTicksSpacing()-1);
         break;
     case Qt::Key_Asterisk:
     case Qt::Key_F:
-        this->fontSize = this->fontSize < 512? this->fontSize+1: 512;
-        this->scene()->update();
+        axisOverlay->setFontSize(axisOverlay->fontSize()+1);
         break;
     case Qt::Key_Slash:
     case Qt::Key_V:
-        this->fontSize = this->fontSize > 1? this->fontSize-1: 1;
-        this->scene()->update();
+        axisOverlay->setFontSize(axisOverlay->fontSize()-1);
+        break;
+    case Qt::Key_T:
+        setTiledRendering(!tiledRendering());
         break;
     case Qt::Key_Space:
         // Back to default settings
-        this->showAxis = true;
-        this->xTicksSpacing = 50;
-        this->yTicksSpacing = 35;
-        this->fontSize = 11;
-        this->scene()->update();
+        axisOverlay->resetSettings();
+        axisOverlay->show();
         break;
     default:
         QGraphicsView::keyPressEvent(event);
@@ -302,8 +458,37 @@ void Figure2D::resizeEvent(QResizeEvent *event)
     if (event->oldSize().width() > 0 && event->oldSize().height())
         this->scale((double)event->size().width() / event->oldSize().width(),
                     (double)event->size().height() / event->oldSize().height());
+    notifyZoom();
 
     QGraphicsView::resizeEvent(event);
+    axisOverlay->fitViewport();
+}
+
+void Figure2D::scrollContentsBy(int dx, int dy)
+{
+    QGraphicsView::scrollContentsBy(dx, dy);
+    // With throttled updates (NoViewportUpdate mode) QGraphicsView does not repaint on scroll
+    if (maxFps > 0)
+        viewport()->update();
+}
+
+void Figure2D::renderExport(QPainter *painter, const QSize &size)
+{
+    this->render(painter);
+    if (axisOverlay->isHidden())
+        return;
+
+    // Same mapping of the viewport as render(): scaled to fit, keeping aspect ratio, and centered
+    const QSizeF source = viewport()->size();
+    if (source.isEmpty())
+        return;
+    const double scale = qMin(size.width() / source.width(), size.height() / source.height());
+    painter->save();
+    painter->translate(size.width() / 2.0, size.height() / 2.0);
+    painter->scale(scale, scale);
+    painter->translate(-source.width() / 2, -source.height() / 2);
+    axisOverlay->paintAxes(painter);
+    painter->restore();
 }
 
 void Figure2D::exportGraphics(QString fileName)
@@ -320,10 +505,19 @@ void Figure2D::exportGraphics(QString fileName)
     if (fileName.isEmpty())
         return;
 
+    // Pending changes must be in the export
+    scene()->updateDirtyItems();
+
     // Append .png if no extension was specified
     if (fileName.indexOf('.',1) < 0) // Search '.' from the second character (*nix hidden files start with a dot)
         fileName.append(".png");
 
+    // Always export at full quality. Items are rendered directly: tiles may not be complete
+    // in progressive mode, and would be embedded as bitmaps in SVG files
+    endInteraction();
+    TileRenderer *renderer = tileRenderer;
+    tileRenderer = 0;
+
     // Save as raster
     if (fileName.endsWith(".jpg", Qt::CaseInsensitive)
             || fileName.endsWith(".jpeg", Qt::CaseInsensitive)
@@ -334,7 +528,7 @@ void Figure2D::exportGraphics(QString fileName)
         image.fill(QColor(255,255,255,0));
         QPainter painter;
         painter.begin(&image);
-        this->render(&painter);
+        renderExport(&painter, this->size());
         painter.end();
         image.save(fileName);
     }
@@ -349,7 +543,8 @@ void Figure2D::exportGraphics(QString fileName)
         generator.setDescription(tr("Graphics generated with VIBes on %1.").arg(QDateTime::currentDateTime().toString()));
         QPainter painter;
         painter.begin(&generator);
-        this->render(&painter);
+        renderExport(&painter, this->size());
         painter.end();
     }
+    tileRenderer = renderer;
 }
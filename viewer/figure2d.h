@@ -5,10 +5,14 @@
 #include <QGraphicsView>
 
 #include <QHash>
+#include <QElapsedTimer>
 
 #include <vibesscene2d.h>
 class QComboBox;
 class QLabel;
+class TileRenderer;
+class AxisOverlay;
+class QTimer;
 
 class Figure2D : public QGraphicsView
 {
@@ -20,31 +24,71 @@ class Figure2D : public QGraphicsView
     QLabel *lbProjX, *lbProjY;
 public:
     explicit Figure2D(QWidget *parent = 0);
+    ~Figure2D();
     VibesScene2D* scene() const {return static_cast<VibesScene2D*>( QGraphicsView::scene() );}
+    bool tiledRendering() const { return tileRenderer != 0; }
+    /// Tells the scene if the zoom changed (to be called after scale(), fitInView() or setTransform())
+    void notifyZoom();
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event);
+    void mousePressEvent(QMouseEvent *event);
     void mouseMoveEvent(QMouseEvent *event);
-    void drawForeground(QPainter *painter, const QRectF &rect);
+    void paintEvent(QPaintEvent *event);
     void wheelEvent(QWheelEvent *event);
     void keyPressEvent(QKeyEvent *event);
     void closeEvent(QCloseEvent *event);
     void resizeEvent(QResizeEvent *event);
+    void scrollContentsBy(int dx, int dy);
 
-    // bool to indicate if axis needs to be drawn or not
-    bool showAxis;
+    // Axis ticks and labels, drawn over the viewport
+    AxisOverlay *axisOverlay;
+    // Renders the view and its axes (the overlay is a child widget, not drawn by render())
+    void renderExport(QPainter *painter, const QSize &size);
 
-    int fontSize;
-    int xTicksSpacing;
-    int yTicksSpacing;
+    // Renders the viewport from tiles rasterized in parallel (null if disabled)
+    TileRenderer *tileRenderer;
+    // Progressive rendering: tiles are rendered in time slices between event loop iterations
+    bool progressiveRendering;
+    int progressiveSliceTime;
+    QTimer *progressiveTimer;
+
+    // Adaptive quality: draft rendering while panning/zooming, full quality once input is idle
+    bool adaptiveQuality;
+    bool interacting;
+    QPainter::RenderHints fullQualityHints;
+    QTimer *idleTimer;
+
+    void beginInteraction();
+
+    // Zoom the scene was last told about: items sized in pixels are told when it changes
+    QTransform notifiedZoom;
+
+    // Repaint throttling: scene changes are accumulated and repainted at most maxFps times per second
+    int maxFps;
+    ViewportUpdateMode unthrottledUpdateMode;
+    QRectF pendingUpdate;
+    QTimer *frameTimer;
+    QElapsedTimer lastFrame;
 signals:
 
 public slots:
     void exportGraphics(QString fileName = QString());
-    void setShowAxis(bool value) { showAxis = value;}
+    void setShowAxis(bool value);
+    void setTiledRendering(bool enabled);
+    void setProgressiveRendering(bool enabled);
+    void setProgressiveSliceTime(int msec);
+    void setAdaptiveQuality(bool enabled);
+    void setInteractionIdleDelay(int msec);
+    void setMaxFps(int fps);
 
 protected slots:
     void refreshProjectionSelectors();
+    void invalidateTiles(const QList<QRectF> &region);
+    void renderPendingTiles();
+    void endInteraction();
+    void accumulateUpdate(const QList<QRectF> &region);
+    void flushUpdate();
 
 };
 
@@ -0,0 +1,424 @@
+#include "tilerenderer.h"
+
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QGraphicsItem>
+#include <QGraphicsRectItem>
+#include <QGraphicsEllipseItem>
+#include <QGraphicsPolygonItem>
+#include <QGraphicsPathItem>
+#include <QGraphicsSimpleTextItem>
+#include <QGraphicsPixmapItem>
+#include <QStyleOptionGraphicsItem>
+#include <QPainterPath>
+#include <QFontMetricsF>
+#include <QPicture>
+#include <QtConcurrent>
+#include <QElapsedTimer>
+#include <QMultiMap>
+#include <QSet>
+#include <QLineF>
+
+#include <cmath>
+
+TileRenderer::TileRenderer(QGraphicsView *view, int tileSize, int cacheSizeMB) :
+    _view(view),
+    _tileSize(tileSize),
+    _tiles(cacheSizeMB * 1024), // Cost of a tile is its size in kB
+    _progressive(false),
+    _partialItem(-1),
+    _partialCount(0)
+{
+}
+
+void TileRenderer::paint(QPainter *painter, const QRect &exposed)
+{
+    const QTransform viewTransform = _view->viewportTransform();
+    // Tiles are aligned on the zoomed scene (the view transform without its translation).
+    // The translation is snapped to whole pixels: tiles drawn at fractional positions are
+    // resampled, which blurs them and shows seams between neighbours.
+    const QPoint offset(qRound(viewTransform.dx()), qRound(viewTransform.dy()));
+    const QRectF zoomedExposed = QRectF(exposed).translated(-offset);
+
+    const int x0 = static_cast<int>(std::floor(zoomedExposed.left() / _tileSize));
+    const int x1 = static_cast<int>(std::floor(zoomedExposed.right() / _tileSize));
+    const int y0 = static_cast<int>(std::floor(zoomedExposed.top() / _tileSize));
+    const int y1 = static_cast<int>(std::floor(zoomedExposed.bottom() / _tileSize));
+
+    // Collect visible tiles, and the ones that need to be rasterized
+    QList<Tile> visible, missing;
+    for (int y = y0; y <= y1; ++y)
+    {
+        for (int x = x0; x <= x1; ++x)
+        {
+            Tile tile;
+            TileKey key = { viewTransform.m11(), viewTransform.m12(), viewTransform.m21(), viewTransform.m22(), x, y };
+            tile.key = key;
+            const CachedTile *cached = _tiles.object(key);
+            if (cached && (!cached->outdated || _progressive))
+            {
+                tile.image = cached->image;
+                visible << tile;
+            }
+            if (!cached || cached->outdated)
+            {
+                missing << tile;
+            }
+        }
+    }
+
+    if (_progressive)
+    {
+        // Queue missing tiles, keeping the ones still pending at this zoom level (the exposed
+        // area may be only a part of the viewport). Closest to the center are rendered first.
+        QSet<TileKey> keys;
+        foreach (const TileKey &key, _pending)
+            if (key.m11 == viewTransform.m11() && key.m12 == viewTransform.m12()
+                    && key.m21 == viewTransform.m21() && key.m22 == viewTransform.m22())
+                keys.insert(key);
+        foreach (const Tile &tile, missing)
+            keys.insert(tile.key);
+
+        const QPointF center = QRectF(_view->viewport()->rect()).translated(-offset).center() / _tileSize;
+        QMultiMap<qreal, TileKey> byDistance;
+        foreach (const TileKey &key, keys)
+            byDistance.insert(QLineF(center, QPointF(key.x + 0.5, key.y + 0.5)).length(), key);
+        _pending = byDistance.values();
+    }
+    else if (!missing.isEmpty())
+    {
+        // Scene area covered by the missing tiles
+        QRectF zoomedArea;
+        foreach (const Tile &tile, missing)
+            zoomedArea |= QRectF(tile.key.x * _tileSize, tile.key.y * _tileSize, _tileSize, _tileSize);
+        const QTransform zoomTransform = viewTransform * QTransform::fromTranslate(-viewTransform.dx(), -viewTransform.dy());
+        const QRectF sceneArea = zoomTransform.inverted().mapRect(zoomedArea);
+
+        // Copy visible geometry, then rasterize tiles in parallel
+        const QList<Primitive> primitives = snapshot(sceneArea, viewTransform, missing);
+        QtConcurrent::blockingMap(missing, [this, &primitives](Tile &tile) { rasterize(tile, primitives); });
+
+        foreach (const Tile &tile, missing)
+        {
+            insert(tile);
+            visible << tile;
+        }
+    }
+
+    // Composite tiles on the viewport
+    painter->save();
+    painter->setClipRect(exposed);
+    foreach (const Tile &tile, visible)
+    {
+        painter->drawImage(QPoint(tile.key.x * _tileSize + offset.x(), tile.key.y * _tileSize + offset.y()), tile.image);
+    }
+    painter->restore();
+}
+
+void TileRenderer::renderPending(int msec)
+{
+    if (!_view->scene())
+    {
+        _pending.clear();
+        _partialItem = -1;
+        return;
+    }
+
+    const QTransform viewTransform = _view->viewportTransform();
+    const QTransform zoomTransform = viewTransform * QTransform::fromTranslate(-viewTransform.dx(), -viewTransform.dy());
+
+    QElapsedTimer timer;
+    timer.start();
+    while (!_pending.isEmpty())
+    {
+        const TileKey key = _pending.first();
+        // The view was zoomed since the tile was queued
+        if (key.m11 != zoomTransform.m11() || key.m12 != zoomTransform.m12()
+                || key.m21 != zoomTransform.m21() || key.m22 != zoomTransform.m22())
+        {
+            _pending.removeFirst();
+            continue;
+        }
+
+        const QRectF tileRect(key.x * _tileSize, key.y * _tileSize, _tileSize, _tileSize);
+        const QRectF sceneRect = zoomTransform.inverted().mapRect(tileRect);
+        const QList<QGraphicsItem*> items = _view->scene()->items(sceneRect, Qt::IntersectsItemBoundingRect,
+                                                                  Qt::AscendingOrder, viewTransform);
+
+        // Start the tile, or start it again if items were added or removed since the last slice
+        if (_partialItem < 0 || !(_partial.key == key) || _partialCount != items.size())
+        {
+            _partial.key = key;
+            _partial.image = QImage(_tileSize, _tileSize, QImage::Format_ARGB32_Premultiplied);
+            _partial.image.fill(Qt::transparent);
+            _partialItem = 0;
+            _partialCount = items.size();
+        }
+
+        // Items are painted one by one, so that a dense tile does not overrun the slice
+        QPainter painter(&_partial.image);
+        painter.setRenderHints(_view->renderHints());
+        const QTransform sceneToTile = zoomTransform * QTransform::fromTranslate(-tileRect.left(), -tileRect.top());
+        while (_partialItem < items.size())
+        {
+            paintItem(&painter, items.at(_partialItem++), sceneToTile, _partial.image.rect());
+            if (timer.elapsed() >= msec)
+                break;
+        }
+        painter.end();
+
+        if (_partialItem < items.size())
+            return;
+        insert(_partial);
+        _partial.image = QImage();
+        _partialItem = -1;
+        _pending.removeFirst();
+        if (timer.elapsed() >= msec)
+            return;
+    }
+}
+
+void TileRenderer::paintItem(QPainter *painter, QGraphicsItem *item, const QTransform &sceneTransform, const QRectF &exposed) const
+{
+    if (!item->isVisible() || (item->flags() & QGraphicsItem::ItemHasNoContents))
+        return;
+    // Groups only draw their children, which are painted separately
+    if (dynamic_cast<QGraphicsItemGroup*>(item))
+        return;
+    const qreal opacity = item->effectiveOpacity();
+    if (opacity <= 0.)
+        return;
+
+    // Same options as QGraphicsScene: only the part of the item on the device is exposed
+    const QTransform transform = item->deviceTransform(sceneTransform);
+    QStyleOptionGraphicsItem option;
+    option.rect = item->boundingRect().toAlignedRect();
+    option.exposedRect = item->boundingRect() & transform.inverted().mapRect(exposed.adjusted(-2, -2, 2, 2));
+
+    painter->save();
+    painter->setWorldTransform(transform);
+    painter->setOpacity(opacity);
+    item->paint(painter, &option, 0);
+    painter->restore();
+}
+
+void TileRenderer::insert(const Tile &tile)
+{
+    CachedTile *cached = new CachedTile;
+    cached->image = tile.image;
+    cached->outdated = false;
+    _tiles.insert(tile.key, cached, _tileSize * _tileSize * 4 / 1024);
+}
+
+void TileRenderer::invalidate()
+{
+    _pending.clear();
+    _partialItem = -1;
+    if (!_progressive)
+    {
+        _tiles.clear();
+        return;
+    }
+    // Keep showing the tiles until they are rendered again
+    foreach (const TileKey &key, _tiles.keys())
+        _tiles.object(key)->outdated = true;
+}
+
+void TileRenderer::invalidate(const QList<QRectF> &sceneRects)
+{
+    foreach (const TileKey &key, _tiles.keys())
+    {
+        if (intersects(key, sceneRects))
+            _tiles.object(key)->outdated = true;
+    }
+    // The tile being rendered may already have painted the changed items: start it again
+    if (_partialItem >= 0 && intersects(_partial.key, sceneRects))
+        _partialItem = -1;
+}
+
+bool TileRenderer::intersects(const TileKey &key, const QList<QRectF> &sceneRects) const
+{
+    const QTransform zoom(key.m11, key.m12, key.m21, key.m22, 0., 0.);
+    const QRectF tileRect(key.x * _tileSize, key.y * _tileSize, _tileSize, _tileSize);
+    foreach (const QRectF &rect, sceneRects)
+    {
+        // Margin for antialiasing and cosmetic pens
+        if (zoom.mapRect(rect).adjusted(-2, -2, 2, 2).intersects(tileRect))
+            return true;
+    }
+    return false;
+}
+
+QList<TileRenderer::Primitive> TileRenderer::snapshot(const QRectF &sceneRect, const QTransform &viewTransform, const QList<Tile> &tiles) const
+{
+    QList<Primitive> primitives;
+    if (!_view->scene())
+        return primitives;
+
+    const QTransform removeOffset = QTransform::fromTranslate(-viewTransform.dx(), -viewTransform.dy());
+    const QList<QGraphicsItem*> items = _view->scene()->items(sceneRect, Qt::IntersectsItemBoundingRect,
+                                                              Qt::AscendingOrder, viewTransform);
+    primitives.reserve(items.size());
+
+    foreach (QGraphicsItem *item, items)
+    {
+        if (!item->isVisible() || (item->flags() & QGraphicsItem::ItemHasNoContents))
+            continue;
+        // Groups only draw their children, which are snapshot separately
+        if (dynamic_cast<QGraphicsItemGroup*>(item))
+            continue;
+
+        Primitive p;
+        p.opacity = item->effectiveOpacity();
+        if (p.opacity <= 0.)
+            continue;
+        p.transform = item->deviceTransform(viewTransform) * removeOffset;
+        p.bounds = p.transform.mapRect(item->boundingRect()).adjusted(-2, -2, 2, 2);
+        p.startAngle = p.spanAngle = 0;
+        p.fillRule = Qt::OddEvenFill;
+
+        if (QGraphicsRectItem *rect = dynamic_cast<QGraphicsRectItem*>(item))
+        {
+            p.kind = Primitive::Rect;
+            p.pen = rect->pen();
+            p.brush = rect->brush();
+            p.rect = rect->rect();
+        }
+        else if (QGraphicsEllipseItem *ellipse = dynamic_cast<QGraphicsEllipseItem*>(item))
+        {
+            p.kind = Primitive::Ellipse;
+            p.pen = ellipse->pen();
+            p.brush = ellipse->brush();
+            p.rect = ellipse->rect();
+            p.startAngle = ellipse->startAngle();
+            p.spanAngle = ellipse->spanAngle();
+        }
+        else if (QGraphicsPolygonItem *polygon = dynamic_cast<QGraphicsPolygonItem*>(item))
+        {
+            p.kind = Primitive::Polygon;
+            p.pen = polygon->pen();
+            p.brush = polygon->brush();
+            p.fillRule = polygon->fillRule();
+            p.outlines << polygon->polygon();
+        }
+        else if (QGraphicsPathItem *path = dynamic_cast<QGraphicsPathItem*>(item))
+        {
+            // Paths are flattened: painting a shared QPainterPath from several threads is not safe
+            p.kind = Primitive::Path;
+            p.pen = path->pen();
+            p.brush = path->brush();
+            p.fillRule = path->path().fillRule();
+            if (p.brush.style() != Qt::NoBrush)
+                p.fills = path->path().toFillPolygons();
+            if (p.pen.style() != Qt::NoPen)
+                p.outlines = path->path().toSubpathPolygons();
+        }
+        else if (QGraphicsSimpleTextItem *text = dynamic_cast<QGraphicsSimpleTextItem*>(item))
+        {
+            QPainterPath textPath;
+            textPath.addText(QPointF(0., QFontMetricsF(text->font()).ascent()), text->font(), text->text());
+            p.kind = Primitive::Path;
+            p.pen = text->pen();
+            p.brush = text->brush();
+            p.fillRule = Qt::WindingFill;
+            p.fills = textPath.toFillPolygons();
+        }
+        else if (QGraphicsPixmapItem *pixmap = dynamic_cast<QGraphicsPixmapItem*>(item))
+        {
+            p.kind = Primitive::Image;
+            p.image = pixmap->pixmap().toImage();
+            p.offset = pixmap->offset();
+        }
+        else
+        {
+            // Other items (batches, glyphs...) record their painting commands for each tile,
+            // so that they only paint the part exposed in the tile, at its level of detail
+            p.kind = Primitive::Picture;
+            foreach (const Tile &tile, tiles)
+            {
+                const QRectF tileRect(tile.key.x * _tileSize, tile.key.y * _tileSize, _tileSize, _tileSize);
+                if (!p.bounds.intersects(tileRect))
+                    continue;
+                QPicture picture;
+                QPainter recorder(&picture);
+                paintItem(&recorder, item, viewTransform * removeOffset * QTransform::fromTranslate(-tileRect.left(), -tileRect.top()),
+                          QRectF(0, 0, _tileSize, _tileSize));
+                recorder.end();
+                p.pictures.insert(qMakePair(tile.key.x, tile.key.y), QByteArray(picture.data(), picture.size()));
+            }
+        }
+        primitives << p;
+    }
+    return primitives;
+}
+
+void TileRenderer::rasterize(Tile &tile, const QList<Primitive> &primitives) const
+{
+    tile.image = QImage(_tileSize, _tileSize, QImage::Format_ARGB32_Premultiplied);
+    tile.image.fill(Qt::transparent);
+
+    const QRectF tileRect(tile.key.x * _tileSize, tile.key.y * _tileSize, _tileSize, _tileSize);
+    const QTransform tileOffset = QTransform::fromTranslate(-tileRect.left(), -tileRect.top());
+
+    QPainter painter(&tile.image);
+    painter.setRenderHints(_view->renderHints());
+    for (int i = 0; i < primitives.size(); ++i)
+    {
+        const Primitive &p = primitives.at(i);
+        if (!p.bounds.intersects(tileRect))
+            continue;
+        // Pictures are recorded in tile coordinates, with the item opacity
+        painter.setTransform(p.kind == Primitive::Picture ? QTransform() : p.transform * tileOffset);
+        painter.setOpacity(p.kind == Primitive::Picture ? 1. : p.opacity);
+        p.paint(&painter, tile.key);
+    }
+}
+
+void TileRenderer::Primitive::paint(QPainter *painter, const TileKey &key) const
+{
+    switch (kind)
+    {
+    case Rect:
+        painter->setPen(pen);
+        painter->setBrush(brush);
+        painter->drawRect(rect);
+        break;
+    case Ellipse:
+        painter->setPen(pen);
+        painter->setBrush(brush);
+        if (spanAngle != 0 && qAbs(spanAngle) % (360 * 16) == 0)
+            painter->drawEllipse(rect);
+        else
+            painter->drawPie(rect, startAngle, spanAngle);
+        break;
+    case Polygon:
+        painter->setPen(pen);
+        painter->setBrush(brush);
+        painter->drawPolygon(outlines.first(), fillRule);
+        break;
+    case Path:
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(brush);
+        foreach (const QPolygonF &polygon, fills)
+            painter->drawPolygon(polygon, fillRule);
+        painter->setPen(pen);
+        painter->setBrush(Qt::NoBrush);
+        foreach (const QPolygonF &polygon, outlines)
+            painter->drawPolyline(polygon);
+        break;
+    case Image:
+        painter->drawImage(offset, image);
+        break;
+    case Picture:
+    {
+        // Each thread replays its own copy of the recorded commands
+        const QByteArray picture = pictures.value(qMakePair(key.x, key.y));
+        if (picture.isEmpty())
+            break;
+        QPicture recorded;
+        recorded.setData(picture.constData(), picture.size());
+        recorded.play(painter);
+        break;
+    }
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef TILERENDERER_H
+#define TILERENDERER_H
+
+#include <QCache>
+#include <QImage>
+#include <QList>
+#include <QPen>
+#include <QBrush>
+#include <QPolygonF>
+#include <QTransform>
+#include <QByteArray>
+#include <QPainter>
+#include <QHash>
+#include <QPair>
+
+class QGraphicsView;
+class QGraphicsItem;
+
+#if QT_VERSION >= 0x060000
+typedef size_t TileHash;
+#else
+typedef uint TileHash;
+#endif
+
+/// Identifies a tile: the zoom part of the view transform (without translation), and
+/// the position of the tile in the zoomed scene, in tile units.
+struct TileKey
+{
+    qreal m11, m12, m21, m22;
+    int x, y;
+
+    bool operator==(const TileKey &other) const {
+        return x == other.x && y == other.y
+                && m11 == other.m11 && m12 == other.m12 && m21 == other.m21 && m22 == other.m22;
+    }
+};
+
+inline TileHash qHash(const TileKey &key, TileHash seed = 0)
+{
+    return seed ^ qHash(key.m11) ^ (qHash(key.m22) << 1) ^ (qHash(key.m12) << 2) ^ (qHash(key.m21) << 3)
+            ^ (qHash(key.x) * 31) ^ (qHash(key.y) * 17);
+}
+
+/// Paints the viewport of a QGraphicsView from square tiles rasterized in parallel.
+///
+/// The geometry of the visible items is first copied on the GUI thread into a flat list
+/// of drawing primitives (scene items cannot be accessed from other threads). Missing
+/// tiles are then rasterized from this snapshot by the global thread pool. Tiles are
+/// cached by zoom level and position, so panning only rasterizes newly exposed tiles.
+///
+/// In progressive mode, paint() only draws the cached tiles and queues the missing ones,
+/// which are then rendered by renderPending() in time-limited slices.
+
+class TileRenderer
+{
+public:
+    explicit TileRenderer(QGraphicsView *view, int tileSize = 256, int cacheSizeMB = 256);
+
+    /// Paints the \a exposed part of the viewport with \a painter (viewport coordinates)
+    void paint(QPainter *painter, const QRect &exposed);
+    /// Marks all cached tiles as out of date
+    void invalidate();
+    /// Marks the cached tiles covering \a sceneRects (scene coordinates) as out of date
+    void invalidate(const QList<QRectF> &sceneRects);
+
+    bool isProgressive() const { return _progressive; }
+    void setProgressive(bool progressive) { _progressive = progressive; _pending.clear(); _partialItem = -1; }
+    /// True if tiles queued by the last paint() are not rendered yet
+    bool hasPendingTiles() const { return !_pending.isEmpty(); }
+    /// Renders queued tiles on the calling (GUI) thread for about \a msec milliseconds.
+    /// A tile not finished at the end of the slice is resumed by the next call.
+    void renderPending(int msec);
+
+    int tileSize() const { return _tileSize; }
+
+private:
+    /// A drawing primitive, snapshot of a scene item
+    struct Primitive
+    {
+        enum Kind { Rect, Ellipse, Polygon, Path, Image, Picture };
+        Kind kind;
+        QTransform transform;       // Item to zoomed scene coordinates
+        QRectF bounds;              // Bounding rect in zoomed scene coordinates
+        qreal opacity;
+        QPen pen;
+        QBrush brush;
+        QRectF rect;                // Rect and Ellipse
+        int startAngle, spanAngle;  // Ellipse
+        QList<QPolygonF> fills;     // Path: filled with brush, no outline
+        QList<QPolygonF> outlines;  // Path: stroked with pen. Polygon: the polygon
+        Qt::FillRule fillRule;
+        QImage image;               // Image
+        QPointF offset;
+        // Picture: recorded QPicture data of each tile (x, y), in tile coordinates
+        QHash<QPair<int,int>, QByteArray> pictures;
+
+        void paint(QPainter *painter, const TileKey &key) const;
+    };
+
+    struct Tile
+    {
+        TileKey key;
+        QImage image;
+    };
+
+    /// A cached tile. Out of date tiles are still shown until they are rendered again.
+    struct CachedTile
+    {
+        QImage image;
+        bool outdated;
+    };
+
+    QList<Primitive> snapshot(const QRectF &sceneRect, const QTransform &viewTransform, const QList<Tile> &tiles) const;
+    void rasterize(Tile &tile, const QList<Primitive> &primitives) const;
+    void insert(const Tile &tile);
+    /// True if the tile \a key covers a part of \a sceneRects (scene coordinates)
+    bool intersects(const TileKey &key, const QList<QRectF> &sceneRects) const;
+    /// Paints \a item with its own paint() function. \a sceneTransform maps the scene to the
+    /// device, and \a exposed is the painted area of the device.
+    void paintItem(QPainter *painter, QGraphicsItem *item, const QTransform &sceneTransform, const QRectF &exposed) const;
+
+    QGraphicsView *_view;
+    int _tileSize;
+    QCache<TileKey, CachedTile> _tiles;
+
+    bool _progressive;
+    // Tiles to render in progressive mode, closest to the viewport center first
+    QList<TileKey> _pending;
+    // Tile being rendered item by item: index of the next item to paint (-1 if none), and
+    // number of items in the tile when it was started
+    Tile _partial;
+    int _partialItem, _partialCount;
+};
+
+#endif // TILERENDERER_H
@@ -8,7 +8,10 @@
 #include <QGraphicsItemGroup>
 #include <QGraphicsPathItem>
 #include <QPainterPath>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
 #include <QGraphicsPixmapItem>
+#include <QGraphicsView>
 #include <QPixmap>
 #include <QBitmap>
 #include <QJsonObject>
@@ -17,6 +20,7 @@
 
 #include <QDebug>
 #include <cmath>
+#include <climits>
 using namespace std;
 
 // The only instance of VibesDefaults
@@ -25,6 +29,61 @@ VibesDefaults VibesDefaults::_instance;
 VibesDefaults::VibesDefaults()
 {
     initDefaultBrushesAndPens();
+    initPredefinedColorNames();
+}
+
+/// Initializes the table of hexadecimal and short names of Qt predefined colors
+
+void VibesDefaults::initPredefinedColorNames()
+{
+    _predefinedColorNames["none"] = "transparent";
+    _predefinedColorNames["#0000FF"] = "blue";
+    _predefinedColorNames["b"] = "blue";
+    _predefinedColorNames["#00FFFF"] = "cyan";
+    _predefinedColorNames["c"] = "cyan";
+    _predefinedColorNames["#00FF00"] = "green";
+    _predefinedColorNames["g"] = "green";
+    _predefinedColorNames["#FFFF00"] = "yellow";
+    _predefinedColorNames["y"] = "yellow";
+    _predefinedColorNames["#FF0000"] = "red";
+    _predefinedColorNames["r"] = "red";
+    _predefinedColorNames["#FF00FF"] = "magenta";
+    _predefinedColorNames["m"] = "magenta";
+    _predefinedColorNames["#FFFFFF"] = "white";
+    _predefinedColorNames["w"] = "white";
+    _predefinedColorNames["#000000"] = "black";
+    _predefinedColorNames["k"] = "black";
+    _predefinedColorNames["#C0C0C0"] = "lightGray";
+    _predefinedColorNames["#A0A0A4"] = "gray";
+    _predefinedColorNames["#808080"] = "darkGray";
+    _predefinedColorNames["#000080"] = "darkBlue";
+    _predefinedColorNames["#008080"] = "darkCyan";
+    _predefinedColorNames["#008000"] = "darkGreen";
+    _predefinedColorNames["#808000"] = "darkYellow";
+    _predefinedColorNames["#800000"] = "darkRed";
+    _predefinedColorNames["#800080"] = "darkMagenta";
+}
+
+int VibesDefaults::styleId(const QString &edgeColor, const QString &faceColor, const QString &lineStyle, const QString &lineWidth)
+{
+    VibesStyleKey key;
+    key.edgeColor = edgeColor;
+    key.faceColor = faceColor;
+    key.lineStyle = lineStyle;
+    key.lineWidth = lineWidth;
+
+    QHash<VibesStyleKey, int>::const_iterator it = _styleIds.constFind(key);
+    if (it != _styleIds.constEnd())
+        return it.value();
+
+    // New style: resolve pen and brush once
+    VibesStyle style;
+    style.properties = key;
+    style.pen = pen(edgeColor, lineStyle, lineWidth);
+    style.brush = brush(faceColor);
+    _styles.append(style);
+    _styleIds.insert(key, _styles.size() - 1);
+    return _styles.size() - 1;
 }
 
 /// Initializes brushes and pens for default color names
@@ -79,26 +138,277 @@ void VibesDefaults::initDefaultBrushesAndPens()
     ADD_DEFAULT_BRUSH_AND_PEN(darkBlue);
 }
 
+quint64 VibesGraphicsItem::_lastGeometryRevision = 0;
+
 VibesGraphicsItem::VibesGraphicsItem(QGraphicsItem *qGraphicsItem)
-: _qGraphicsItem(qGraphicsItem), _nbDim(0), _dimX(-1), _dimY(-1)
+: _qGraphicsItem(qGraphicsItem), _nbDim(0), _dimX(-1), _dimY(-1),
+  _geometryRevision(++_lastGeometryRevision), _styleId(-1),
+  _dirtyGeometry(false), _dirtyStyle(false),
+  _hasPose(false), _poseX(0.), _poseY(0.), _poseHeading(0.)
+{
+}
+
+int VibesGraphicsItem::styleId()
+{
+    if (_styleId < 0)
+    {
+        _styleId = vibesDefaults.styleId(jsonValue("EdgeColor").toString(), jsonValue("FaceColor").toString(),
+                                         jsonValue("LineStyle").toString(), jsonValue("LineWidth").toString());
+    }
+    return _styleId;
+}
+
+VibesColorMap::VibesColorMap()
+{
+    setStops(QStringList() << "#440154" << "#482878" << "#3e4989" << "#31688e" << "#26828e"
+                           << "#1f9e89" << "#35b779" << "#6ece58" << "#b5de2b" << "#fde725");
+}
+
+bool VibesColorMap::fromJson(const QJsonValue &value, VibesColorMap &colorMap)
+{
+    QStringList colors;
+    if (value.isArray())
+    {
+        foreach (const QJsonValue color, value.toArray())
+            colors << color.toString();
+    }
+    else if (value.toString() == "viridis")
+    {
+        colorMap = VibesColorMap();
+        return true;
+    }
+    else if (value.toString() == "jet")
+    {
+        colors << "#00007f" << "#0000ff" << "#007fff" << "#00ffff" << "#7fff7f"
+               << "#ffff00" << "#ff7f00" << "#ff0000" << "#7f0000";
+    }
+    else if (value.toString() == "hot")
+    {
+        colors << "#000000" << "#ff0000" << "#ffff00" << "#ffffff";
+    }
+    else if (value.toString() == "gray")
+    {
+        colors << "#000000" << "#ffffff";
+    }
+    if (colors.isEmpty())
+        return false;
+    colorMap.setStops(colors);
+    return true;
+}
+
+void VibesColorMap::setStops(const QStringList &colors)
+{
+    // Colors are interpolated once, in a table of 256 entries
+    QVector<QColor> stops;
+    foreach (const QString &name, colors)
+        stops << vibesDefaults.brush(name).color();
+    _table.resize(256);
+    for (int i = 0; i < _table.size(); ++i)
+    {
+        const double t = (stops.size() > 1) ? i * (stops.size() - 1) / 255. : 0.;
+        const int k = qMin(int(t), stops.size() - 1);
+        const QColor &c0 = stops.at(k);
+        const QColor &c1 = stops.at(qMin(k + 1, stops.size() - 1));
+        const double f = t - k;
+        _table[i] = qRgba(qRound(c0.red() + f * (c1.red() - c0.red())),
+                          qRound(c0.green() + f * (c1.green() - c0.green())),
+                          qRound(c0.blue() + f * (c1.blue() - c0.blue())),
+                          qRound(c0.alpha() + f * (c1.alpha() - c0.alpha())));
+    }
+}
+
+void VibesColorMap::map(const double *values, int count, double min, double max, QRgb *colors) const
+{
+    const QRgb *table = _table.constData();
+    const double last = _table.size() - 1;
+    const double scale = (max > min) ? last / (max - min) : 0.;
+    // Branchless clamping, so that the loop can be vectorized (NaN values get the first color)
+    for (int i = 0; i < count; ++i)
+    {
+        double t = (values[i] - min) * scale;
+        t = t > 0. ? t : 0.;
+        t = t < last ? t : last;
+        colors[i] = table[int(t)];
+    }
+}
+
+void VibesColorMap::map(const double *values, int count, const QJsonValue &range, QRgb *colors) const
+{
+    const QJsonArray bounds = range.toArray();
+    if (bounds.size() == 2)
+    {
+        map(values, count, bounds[0].toDouble(), bounds[1].toDouble(), colors);
+        return;
+    }
+    if (count == 0)
+        return;
+    // Separate min/max reductions (vectorized)
+    double min = values[0], max = values[0];
+    for (int i = 1; i < count; ++i)
+        min = values[i] < min ? values[i] : min;
+    for (int i = 1; i < count; ++i)
+        max = values[i] > max ? values[i] : max;
+    map(values, count, min, max, colors);
+}
+
+bool VibesMatrix::fromJson(const QJsonValue &value, VibesMatrix &matrix)
+{
+    if (!value.isArray()) return false;
+    const QJsonArray array = value.toArray();
+    if (array.isEmpty()) return false;
+
+    VibesMatrix m;
+    // Vector of numbers
+    if (!array.first().isArray())
+    {
+        m._isVector = true;
+        m._rows = 1;
+        m._cols = array.size();
+        m._data.reserve(m._cols);
+        foreach (const QJsonValue v, array)
+        {
+            if (!v.isDouble()) return false;
+            m._data.append(v.toDouble());
+        }
+    }
+    // Matrix: rows of numbers, all of the same size
+    else
+    {
+        m._rows = array.size();
+        m._cols = array.first().toArray().size();
+        if (m._cols == 0) return false;
+        m._data.reserve(m._rows * m._cols);
+        foreach (const QJsonValue row, array)
+        {
+            const QJsonArray coords = row.toArray();
+            if (!row.isArray() || coords.size() != m._cols) return false;
+            foreach (const QJsonValue v, coords)
+            {
+                if (!v.isDouble()) return false;
+                m._data.append(v.toDouble());
+            }
+        }
+    }
+    matrix = m;
+    return true;
+}
+
+QJsonValue VibesMatrix::toJson() const
+{
+    if (_isVector)
+    {
+        QJsonArray vector;
+        foreach (double v, _data)
+            vector.append(v);
+        return vector;
+    }
+    QJsonArray rows;
+    for (int i = 0; i < _rows; ++i)
+    {
+        QJsonArray coords;
+        for (int j = 0; j < _cols; ++j)
+            coords.append(at(i, j));
+        rows.append(coords);
+    }
+    return rows;
+}
+
+QVector<double> VibesMatrix::gather(const QVector<int> &columns) const
 {
+    QVector<double> result(columns.size() * _rows);
+    const double *in = _data.constData();
+    double *out = result.data();
+    const int stride = _cols;
+    for (int c = 0; c < columns.size(); ++c)
+    {
+        // Strided loads, contiguous stores and no aliasing: this loop is auto-vectorized
+        const double * const src = in + columns.at(c);
+        double * const dst = out + c * _rows;
+        for (int i = 0; i < _rows; ++i)
+            dst[i] = src[i * stride];
+    }
+    return result;
 }
 
 bool VibesGraphicsItem::setJson(QJsonObject json, int dimX, int dimY)
 {
-    if (!parseJson(json)) return false;
+    // Numeric arrays are moved out of the JSON object into compact storage
+    QHash<QString, VibesMatrix> previousMatrices = _matrices;
+    _matrices.clear();
+    foreach (const QString &key, json.keys())
+    {
+        VibesMatrix matrix;
+        if (propertyIsCompact(key) && VibesMatrix::fromJson(json[key], matrix))
+        {
+            _matrices[key] = matrix;
+            json.remove(key);
+        }
+    }
+
+    if (!parseJson(json))
+    {
+        _matrices = previousMatrices;
+        return false;
+    }
     _json = json;
+    invalidateProjections();
+    invalidateStyle();
+    clearPose();
 
-    setProj(dimX, dimY);
+    // Geometry is built once the item is in the scene, and all its properties are known
+    _dimX = dimX;
+    _dimY = dimY;
+    markDirty(true);
     return true;
 }
 
+QJsonObject VibesGraphicsItem::json() const
+{
+    // Rebuild the properties kept in compact storage
+    QJsonObject json = _json;
+    for (QHash<QString, VibesMatrix>::const_iterator it = _matrices.constBegin(); it != _matrices.constEnd(); ++it)
+        json[it.key()] = it.value().toJson();
+    return json;
+}
+
+QVector<QRgb> VibesGraphicsItem::elementColors(int count) const
+{
+    QVector<QRgb> colors;
+    const VibesMatrix rgba = matrix("Colors");
+    const VibesMatrix levels = matrix("ColorLevels");
+    if (!rgba.isEmpty() && !rgba.isVector() && rgba.rows() == count && (rgba.cols() == 3 || rgba.cols() == 4))
+    {
+        // One (r,g,b[,a]) row per element, components in [0,255]
+        colors.resize(count);
+        const int cols = rgba.cols();
+        const double *c = rgba.data().constData();
+        for (int i = 0; i < count; ++i, c += cols)
+        {
+            colors[i] = qRgba(qBound(0, int(c[0]), 255), qBound(0, int(c[1]), 255), qBound(0, int(c[2]), 255),
+                              cols == 4 ? qBound(0, int(c[3]), 255) : 255);
+        }
+    }
+    else if (!levels.isEmpty() && levels.data().size() == count)
+    {
+        // Levels mapped in one pass through the color map
+        VibesColorMap colorMap;
+        VibesColorMap::fromJson(jsonValue("ColorMap"), colorMap);
+        colors.resize(count);
+        colorMap.map(levels.data().constData(), count, jsonValue("ColorRange"), colors.data());
+    }
+    return colors;
+}
+
 QJsonValue VibesGraphicsItem::jsonValue(const QString& key) const
 {
     // If object has the requested property, return it
-    if (json().contains(key))
+    if (_json.contains(key))
+    {
+        return _json[key];
+    }
+    else if (_matrices.contains(key))
     {
-        return json()[key];
+        return _matrices[key].toJson();
     }
         // Else, return the property from its parent group
     else
@@ -128,9 +438,54 @@ void VibesGraphicsItem::setJsonValue(const QString &key, const QJsonValue &value
     setJsonValues(jsonObject);
 }
 
+void VibesGraphicsItem::setStyleValues(const QJsonObject &values)
+{
+    for (QJsonObject::const_iterator prop = values.constBegin(); prop != values.constEnd(); prop++)
+        _json[prop.key()] = prop.value();
+    invalidateStyle();
+    markDirty(false);
+}
+
+QPen VibesGraphicsItem::paintPen(const QPen &pen) const
+{
+    if (!scene() || !scene()->isDraft())
+        return pen;
+    QPen draftPen = pen;
+    draftPen.setWidth(0);
+    draftPen.setStyle(Qt::SolidLine);
+    return draftPen;
+}
+
+void VibesGraphicsItem::markDirty(bool geometry)
+{
+    if (geometry)
+        _dirtyGeometry = true;
+    else
+        _dirtyStyle = true;
+    if (scene())
+        scene()->scheduleUpdate(this);
+}
+
+void VibesGraphicsItem::updateGraphics()
+{
+    if (_dirtyGeometry)
+    {
+        setProj(_dimX, _dimY);
+    }
+    else if (_dirtyStyle)
+    {
+        _dirtyStyle = false;
+        updateStyle();
+        // Pen width is part of the bounds
+        if (scene())
+            scene()->updateItemBounds(this, existsInProj(_dimX, _dimY));
+    }
+}
+
 void VibesGraphicsItem::setJsonValues(const QJsonObject &values)
 {
     bool bNeedProjection = false;
+    invalidateStyle();
 
     for (QJsonObject::const_iterator prop = values.constBegin(); prop != values.constEnd(); prop++)
     {
@@ -138,7 +493,18 @@ void VibesGraphicsItem::setJsonValues(const QJsonObject &values)
         if (propertyIsReadOnly(prop.key()))
             continue;
         // Set or update property value
-        _json[prop.key()] = prop.value();
+        VibesMatrix matrix;
+        if (propertyIsCompact(prop.key()) && VibesMatrix::fromJson(prop.value(), matrix))
+        {
+            _matrices[prop.key()] = matrix;
+            _json.remove(prop.key());
+            invalidateProjections();
+        }
+        else
+        {
+            _matrices.remove(prop.key());
+            _json[prop.key()] = prop.value();
+        }
 
         // Check if we need to update projection
         if (propertyChangesGeometry(prop.key()))
@@ -147,14 +513,14 @@ void VibesGraphicsItem::setJsonValues(const QJsonObject &values)
 
     // Update graphics with new Json
     parseJson(_json);
-
+    // A new geometry replaces the pose
     if (bNeedProjection)
-        computeProjection(_dimX, _dimY);
+        clearPose();
 
-    // Apply property change
+    // Apply property change (groups pass their properties to their children in parseJson)
     if (this->_qGraphicsItem->type() != VibesGraphicsGroupType)
     {
-        this->updateProj();
+        markDirty(bNeedProjection);
     }
 }
 
@@ -162,15 +528,160 @@ bool VibesGraphicsItem::setProj(int dimX, int dimY)
 {
     _dimX = dimX;
     _dimY = dimY;
-    if (existsInProj(_dimX, _dimY))
-    {
-        return computeProjection(_dimX, _dimY);
-    }
-    else
-    {
-        /// \todo Change visibility to none when projection is not available
+    _dirtyGeometry = false;
+    _dirtyStyle = false;
+    /// \todo Change visibility to none when projection is not available
+    bool visible = existsInProj(_dimX, _dimY) && computeProjection(_dimX, _dimY);
+    if (_hasPose)
+        applyPose();
+    // Keep the bounds of the scene up to date
+    if (scene())
+        scene()->updateItemBounds(this, visible);
+    return visible;
+}
+
+bool VibesGraphicsItem::setPose(double x, double y, double heading)
+{
+    // Text items already use their transform
+    if (!_qGraphicsItem || _qGraphicsItem->type() == VibesGraphicsTextType)
         return false;
+    _hasPose = true;
+    _poseX = x;
+    _poseY = y;
+    _poseHeading = heading;
+    applyPose();
+
+    // Bounds of the item, or of the items nested in a group
+    if (VibesScene2D *scene = this->scene())
+    {
+        QList<QGraphicsItem*> moved;
+        moved << _qGraphicsItem;
+        for (int i = 0; i < moved.size(); ++i)
+        {
+            VibesGraphicsItem *item = qgraphicsitem_cast<VibesGraphicsItem*>(moved.at(i));
+            if (!item)
+                continue;
+            if (moved.at(i)->type() == VibesGraphicsGroupType)
+                moved << moved.at(i)->childItems();
+            else
+                scene->updateItemBounds(item, item->existsInProj(item->dimX(), item->dimY()));
+        }
     }
+    return true;
+}
+
+void VibesGraphicsItem::clearPose()
+{
+    if (!_hasPose)
+        return;
+    _hasPose = false;
+    _qGraphicsItem->setTransform(QTransform());
+}
+
+double VibesGraphicsItem::poseHeading() const
+{
+    return _hasPose ? _poseHeading : _json.value("orientation").toDouble();
+}
+
+void VibesGraphicsItem::applyPose()
+{
+    // Drawn position and heading of the item
+    QPointF origin;
+    const QJsonArray center = _json.value("center").toArray();
+    if (center.size() > qMax(_dimX, _dimY) && _dimX >= 0 && _dimY >= 0)
+        origin = QPointF(center[_dimX].toDouble(), center[_dimY].toDouble());
+    const double orientation = _json.value("orientation").toDouble();
+
+    // Moves the origin to the pose, then turns the item around it
+    QTransform transform;
+    transform.translate(_poseX, _poseY);
+    transform.rotate(_poseHeading - orientation);
+    transform.translate(-origin.x(), -origin.y());
+    _qGraphicsItem->setTransform(transform);
+}
+
+void VibesGraphicsItem::prepareProj(int dimX, int dimY)
+{
+    if (existsInProj(dimX, dimY) && !hasProjection(dimX, dimY))
+        _projections.insert(qMakePair(dimX, dimY), projectGeometry(dimX, dimY));
+}
+
+bool VibesGraphicsItem::projectionSource(int dimX, int dimY, VibesMatrix &matrix, QVector<int> &columns) const
+{
+    QString key;
+    if (!existsInProj(dimX, dimY) || !projectionColumns(dimX, dimY, key, columns))
+        return false;
+    matrix = this->matrix(key);
+    return !matrix.isEmpty();
+}
+
+void VibesGraphicsItem::cacheProjection(const VibesProjection &projection, quint64 revision)
+{
+    // Ignore projections of a previous geometry
+    if (revision == _geometryRevision && !hasProjection(projection.dimX, projection.dimY))
+        _projections.insert(qMakePair(projection.dimX, projection.dimY), projection);
+}
+
+VibesProjection VibesGraphicsItem::projectGeometry(int dimX, int dimY) const
+{
+    VibesMatrix matrix;
+    QVector<int> columns;
+    if (!projectionSource(dimX, dimY, matrix, columns))
+        return VibesProjection();
+    return VibesProjection::fromMatrix(matrix, columns, dimX, dimY);
+}
+
+VibesProjection VibesProjection::fromMatrix(const VibesMatrix &matrix, const QVector<int> &columns, int dimX, int dimY)
+{
+    VibesProjection projection;
+    foreach (int c, columns)
+        if (c < 0 || c >= matrix.cols()) return projection;
+    projection.dimX = dimX;
+    projection.dimY = dimY;
+    projection.rows = matrix.rows();
+    projection.gathered = true;
+    projection.coords = matrix.gather(columns);
+    for (int c = 0; c < columns.size(); ++c)
+        projection.starts << c * projection.rows;
+    return projection;
+}
+
+VibesProjection VibesProjection::inPlace(const VibesMatrix &matrix, const QVector<int> &columns, int dimX, int dimY)
+{
+    VibesProjection projection;
+    foreach (int c, columns)
+        if (c < 0 || c >= matrix.cols()) return projection;
+    projection.dimX = dimX;
+    projection.dimY = dimY;
+    projection.rows = matrix.rows();
+    projection.stride = matrix.cols();
+    // Implicitly shared with the matrix
+    projection.coords = matrix.data();
+    projection.starts = columns;
+    return projection;
+}
+
+const VibesProjection & VibesGraphicsItem::projection(int dimX, int dimY)
+{
+    QHash<QPair<int,int>, VibesProjection>::const_iterator it = _projections.constFind(qMakePair(dimX, dimY));
+    if (it != _projections.constEnd())
+        return it.value();
+    // Not cached (the scene cache may be disabled): the storage columns are used as is
+    if (!_inPlaceProjection.isFor(dimX, dimY))
+    {
+        VibesMatrix matrix;
+        QVector<int> columns;
+        _inPlaceProjection = projectionSource(dimX, dimY, matrix, columns)
+                ? VibesProjection::inPlace(matrix, columns, dimX, dimY) : VibesProjection();
+    }
+    return _inPlaceProjection;
+}
+
+void VibesGraphicsItem::invalidateProjections()
+{
+    _projections.clear();
+    _inPlaceProjection = VibesProjection();
+    _geometryRevision = ++_lastGeometryRevision;
 }
 
 VibesGraphicsItem * VibesGraphicsItem::newWithType(const QString type)
@@ -251,6 +762,26 @@ VibesGraphicsItem * VibesGraphicsItem::newWithType(const QString type)
     {
         return new VibesGraphicsCake();
     }
+    else if (type == "arrows")
+    {
+        return new VibesGraphicsArrows();
+    }
+    else if (type == "pies")
+    {
+        return new VibesGraphicsPies();
+    }
+    else if (type == "ellipses")
+    {
+        return new VibesGraphicsEllipses();
+    }
+    else if (type == "lines" || type == "polygons")
+    {
+        return new VibesGraphicsPolylines();
+    }
+    else if (type == "heatmap")
+    {
+        return new VibesGraphicsHeatmap();
+    }
     return 0;
 }
 
@@ -342,55 +873,57 @@ void VibesGraphicsGroup::addToGroup(VibesGraphicsItem *item)
     // Update dimension
     this->_nbDim = qMax(_nbDim, item->dimension());
     // Update item with group properties
+    item->invalidateStyle();
+    item->markDirty(false);
+}
+
+void VibesGraphicsGroup::clear()
+{
+    // Remove all children at once
+    QList<QGraphicsItem*> children = this->childItems();
     if (VibesGraphicsItem::scene())
     {
-        item->setProj(VibesGraphicsItem::scene()->dimX(), VibesGraphicsItem::scene()->dimY());
+        VibesGraphicsItem::scene()->deleteItems(children);
+        return;
     }
+    for (int i = children.size() - 1; i >= 0; --i)
+        delete children.at(i);
 }
 
-void VibesGraphicsGroup::clear()
+void VibesGraphicsGroup::setStyleValues(const QJsonObject &values)
 {
-    // Remove all children
-    QList<QGraphicsItem*> children = this->childItems();
+    for (QJsonObject::const_iterator prop = values.constBegin(); prop != values.constEnd(); prop++)
+        _json[prop.key()] = prop.value();
+    invalidateStyle();
 
-    foreach(QGraphicsItem* child, children)
+    // Nested items get the same properties
+    foreach(QGraphicsItem* child, this->childItems())
     {
-        VibesGraphicsItem * item = qgraphicsitem_cast<VibesGraphicsItem *>(child);
-        if (item) delete item;
+        if (VibesGraphicsItem * item = qgraphicsitem_cast<VibesGraphicsItem *>(child))
+            item->setStyleValues(values);
     }
 }
 
 bool VibesGraphicsGroup::parseJsonGraphics(const QJsonObject &json)
 {
-    // Set graphical properties
-    QList<QGraphicsItem*> children = this->childItems();
-
-    foreach(QGraphicsItem* child, children)
-    {
-        VibesGraphicsItem * item = qgraphicsitem_cast<VibesGraphicsItem *>(child);
-        // Each item gets the group properties if needed
-        if (item)
-        {
-            if (json["EdgeColor"].toString()!=QString())
-            {
-                item->setJsonValue("EdgeColor",json["EdgeColor"]);
-            }
-            if (json["FaceColor"].toString()!=QString())
-            {
-                item->setJsonValue("FaceColor",json["FaceColor"]);
-            }
-            if (json["LineStyle"].toString()!=QString())
-            {
-                item->setJsonValue("LineStyle",json["LineStyle"]);
-            }
-            if (json["LineWidth"].toString()!=QString())
-            {
-                item->setJsonValue("LineWidth",json["LineWidth"]);
-            }
-            // Update item display
-            item->updateProj();
-        }
-            
+    // Group style properties, given to each item in a single pass
+    QJsonObject values;
+    if (json["EdgeColor"].toString()!=QString())
+        values["EdgeColor"] = json["EdgeColor"];
+    if (json["FaceColor"].toString()!=QString())
+        values["FaceColor"] = json["FaceColor"];
+    if (json["LineStyle"].toString()!=QString())
+        values["LineStyle"] = json["LineStyle"];
+    if (json["LineWidth"].toString()!=QString())
+        values["LineWidth"] = json["LineWidth"];
+    if (values.isEmpty())
+        return true;
+
+    // Items only update their pen and brush, not their geometry
+    foreach(QGraphicsItem* child, this->childItems())
+    {
+        if (VibesGraphicsItem * item = qgraphicsitem_cast<VibesGraphicsItem *>(child))
+            item->setStyleValues(values);
     }
     return true;
 }
@@ -416,8 +949,8 @@ bool VibesGraphicsBox::parseJsonGraphics(const QJsonObject &json)
             this->_nbDim = bounds.size() / 2;
 
             // Set graphical properties
-            this->setPen(vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString()));
-            this->setBrush(vibesDefaults.brush(jsonValue("FaceColor").toString()));
+            this->setPen(style().pen);
+            this->setBrush(style().brush);
 
             // Update successful
             return true;
@@ -433,8 +966,9 @@ bool VibesGraphicsBox::computeProjection(int dimX, int dimY)
     const QJsonObject & json = this->_json;
 
     // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const VibesStyle & style = this->style();
+    const QBrush & brush = style.brush;
+    const QPen & pen = style.pen;
 
     Q_ASSERT(json.contains("type"));
     Q_ASSERT(json["type"].toString() == "box");
@@ -472,6 +1006,12 @@ bool VibesGraphicsBox::computeProjection(int dimX, int dimY)
 // VibesGraphicsBoxes
 //
 
+void VibesGraphicsBoxes::updateElementColors()
+{
+    _colors = elementColors(matrix("bounds").rows());
+    this->update();
+}
+
 bool VibesGraphicsBoxes::parseJsonGraphics(const QJsonObject &json)
 {
     // Now process shape-specific properties
@@ -485,9 +1025,10 @@ bool VibesGraphicsBoxes::parseJsonGraphics(const QJsonObject &json)
         if (type == "boxes")
         {
             // Check that the "bounds" fields is a matrix
-            int nbCols, nbRows;
-            if (!isJsonMatrix(json["bounds"], nbRows, nbCols))
+            const VibesMatrix bounds = matrix("bounds");
+            if (bounds.isEmpty() || bounds.isVector())
                 return false;
+            int nbCols = bounds.cols();
             // Number of bounds has to be even
             if (nbCols % 2 != 0)
                 return false;
@@ -495,24 +1036,12 @@ bool VibesGraphicsBoxes::parseJsonGraphics(const QJsonObject &json)
             if (nbCols < 4)
                 return 0;
 
-            //            bool colors = json.contains("colors");
-            //            bool enoughColors = false;
-            //            if (colors)
-            //                enoughColors = json["colors"].toArray().size() == nbRows;
-
             // Compute dimension
             this->_nbDim = nbCols / 2;
 
             // Set graphical properties
-            QList<QGraphicsItem*> rects = this->childItems();
-
-            foreach(QGraphicsItem* item, rects)
-            {
-                QGraphicsRectItem * rect = qgraphicsitem_cast<QGraphicsRectItem *>(item);
-                if (!rect) continue;
-                rect->setPen(vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString()));
-                rect->setBrush(vibesDefaults.brush(jsonValue("FaceColor").toString()));
-            }
+            this->setPen(style().pen);
+            this->setBrush(style().brush);
 
             // Update successful
             return true;
@@ -528,8 +1057,9 @@ bool VibesGraphicsBoxes::computeProjection(int dimX, int dimY)
     const QJsonObject & json = this->_json;
 
     // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const VibesStyle & style = this->style();
+    const QBrush & brush = style.brush;
+    const QPen & pen = style.pen;
 
     // Now process shape-specific properties
     // (we can only update properties of a shape, but mutation into another type is not supported)
@@ -537,67 +1067,87 @@ bool VibesGraphicsBoxes::computeProjection(int dimX, int dimY)
     // VibesGraphicsBoxes has JSON type "boxes"
     Q_ASSERT(json["type"].toString() == "boxes");
 
-    // VibesGraphicsBoxes is basically a QGraphicsItemGroup containing QGraphicsRectItems
-    // Before update, we first remove all existing rectangles
-    {
-        QList<QGraphicsItem*> rects = this->childItems();
-        foreach(QGraphicsItem* rect, rects) delete rect;
-    }
-    // "bounds" is a matrix
-    Q_ASSERT(isJsonMatrix(json["bounds"]));
-
-    // Fill group with projected boxes
+    // Boxes are painted from the projected bounds: only their bounding rect is computed here
+    const VibesProjection & proj = projection(dimX, dimY);
+    if (proj.rows == 0)
+        return false;
+    const double *lb_x = proj.column(0), *ub_x = proj.column(1), *lb_y = proj.column(2), *ub_y = proj.column(3);
+    const int s = proj.stride;
+
+    // Separate min/max reductions over the columns (vectorized when contiguous)
+    double xmin = lb_x[0], xmax = ub_x[0], ymin = lb_y[0], ymax = ub_y[0];
+    for (int i = 1; i < proj.rows; ++i)
+        xmin = lb_x[i * s] < xmin ? lb_x[i * s] : xmin;
+    for (int i = 1; i < proj.rows; ++i)
+        xmax = ub_x[i * s] > xmax ? ub_x[i * s] : xmax;
+    for (int i = 1; i < proj.rows; ++i)
+        ymin = lb_y[i * s] < ymin ? lb_y[i * s] : ymin;
+    for (int i = 1; i < proj.rows; ++i)
+        ymax = ub_y[i * s] > ymax ? ub_y[i * s] : ymax;
+
+    this->prepareGeometryChange();
+    // Margin for the pen width
+    const double margin = pen.widthF() / 2.;
+    _boundingRect = QRectF(xmin, ymin, xmax - xmin, ymax - ymin).adjusted(-margin, -margin, margin, margin);
 
-    foreach(const QJsonValue value, json["bounds"].toArray())
-    {
-        const QJsonArray box = value.toArray();
-        // Read bounds
-        double lb_x = box[2 * dimX].toDouble();
-        double ub_x = box[2 * dimX + 1].toDouble();
-        double lb_y = box[2 * dimY].toDouble();
-        double ub_y = box[2 * dimY + 1].toDouble();
-        // Create a new rect
-        QGraphicsRectItem * rect = new QGraphicsRectItem(lb_x, lb_y, ub_x - lb_x, ub_y - lb_y);
-        rect->setPen(pen);
-        rect->setBrush(brush);
-        // Add it to the group
-        this->addToGroup(rect);
-    }
-
-    /*
-        QJsonArray boundsX_lb = json["boundsX_lb"].toArray();
-        QJsonArray boundsX_ub = json["boundsX_ub"].toArray();
-        QJsonArray boundsY_lb = json["boundsY_lb"].toArray();
-        QJsonArray boundsY_ub = json["boundsY_ub"].toArray();
-
-        if (boundsX_lb.size() == boundsX_ub.size() &&
-                boundsX_ub.size() == boundsY_lb.size() &&
-                boundsY_lb.size() == boundsY_ub.size())
-        {
-            bool colors = json.contains("colors");
-            bool enoughColors = false;
-            if (colors)
-                enoughColors = json["colors"].toArray().size() == boundsX_lb.size();
-            for (int i = 0; i < boundsX_lb.size(); i++)
-            {
-                // Read bounds
-                double lb_x = boundsX_lb[i].toDouble();
-                double ub_x = boundsX_ub[i].toDouble();
-                double lb_y = boundsY_lb[i].toDouble();
-                double ub_y = boundsY_ub[i].toDouble();
-                // Create a new rect
-                QGraphicsRectItem * rect = new QGraphicsRectItem(lb_x, lb_y, ub_x - lb_x, ub_y - lb_y);
-                rect->setPen(pen);
-                rect->setBrush(brush);
-                // Add it to the group
-                this->addToGroup( rect );
-            }
-     */
+    this->setPen(pen);
+    this->setBrush(brush);
+    _colors = elementColors(proj.rows);
+    // Only repaint the exposed boxes
+    this->setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
 
     // Update successful
     return true;
 }
 
+bool VibesGraphicsBoxes::projectionColumns(int dimX, int dimY, QString &key, QVector<int> &columns) const
+{
+    key = "bounds";
+    columns = QVector<int>() << 2 * dimX << 2 * dimX + 1 << 2 * dimY << 2 * dimY + 1;
+    return true;
+}
+
+void VibesGraphicsBoxes::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+{
+    if (!existsInProj(dimX(), dimY()))
+        return;
+    const VibesProjection & proj = projection(dimX(), dimY());
+    if (proj.rows == 0)
+        return;
+    const double *lb_x = proj.column(0), *ub_x = proj.column(1), *lb_y = proj.column(2), *ub_y = proj.column(3);
+    const int s = proj.stride;
+
+    // Collect visible boxes, and draw them in one call (per color, for boxes with their own colors)
+    const QRectF exposed = option->exposedRect;
+    const bool colored = (_colors.size() == proj.rows);
+    QVector<QRectF> rects;
+    QHash<QRgb, QVector<QRectF> > rectsByColor;
+    if (!colored)
+        rects.reserve(proj.rows);
+    for (int i = 0; i < proj.rows; ++i)
+    {
+        const QRectF rect(lb_x[i * s], lb_y[i * s], ub_x[i * s] - lb_x[i * s], ub_y[i * s] - lb_y[i * s]);
+        if (!rect.intersects(exposed) && !exposed.contains(rect.topLeft()))
+            continue;
+        if (colored)
+            rectsByColor[_colors.at(i)].append(rect);
+        else
+            rects.append(rect);
+    }
+
+    painter->setBrush(brush());
+    painter->setPen(paintPen(pen()));
+    if (!colored)
+    {
+        painter->drawRects(rects);
+        return;
+    }
+    for (QHash<QRgb, QVector<QRectF> >::const_iterator it = rectsByColor.constBegin(); it != rectsByColor.constEnd(); ++it)
+    {
+        painter->setBrush(QColor::fromRgba(it.key()));
+        painter->drawRects(it.value());
+    }
+}
 
 //
 // VibesGraphicsBoxesUnion
@@ -616,9 +1166,10 @@ bool VibesGraphicsBoxesUnion::parseJsonGraphics(const QJsonObject &json)
         if (type == "boxes union")
         {
             // Check that the "bounds" fields is a matrix
-            int nbCols, nbRows;
-            if (!isJsonMatrix(json["bounds"], nbRows, nbCols))
+            const VibesMatrix bounds = matrix("bounds");
+            if (bounds.isEmpty() || bounds.isVector())
                 return false;
+            int nbCols = bounds.cols();
             // Number of bounds has to be even
             if (nbCols % 2 != 0)
                 return false;
@@ -635,8 +1186,8 @@ bool VibesGraphicsBoxesUnion::parseJsonGraphics(const QJsonObject &json)
             this->_nbDim = nbCols / 2;
 
             // Set graphical properties
-            this->setPen(vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString()));
-            this->setBrush(vibesDefaults.brush(jsonValue("FaceColor").toString()));
+            this->setPen(style().pen);
+            this->setBrush(style().brush);
 
             // Update successful
             return true;
@@ -647,34 +1198,43 @@ bool VibesGraphicsBoxesUnion::parseJsonGraphics(const QJsonObject &json)
     return false;
 }
 
+bool VibesGraphicsBoxesUnion::projectionColumns(int dimX, int dimY, QString &key, QVector<int> &columns) const
+{
+    key = "bounds";
+    columns = QVector<int>() << 2 * dimX << 2 * dimX + 1 << 2 * dimY << 2 * dimY + 1;
+    return true;
+}
+
 bool VibesGraphicsBoxesUnion::computeProjection(int dimX, int dimY)
 {
     const QJsonObject & json = this->_json;
 
     // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const VibesStyle & style = this->style();
+    const QBrush & brush = style.brush;
+    const QPen & pen = style.pen;
 
     // Now process shape-specific properties
     // (we can only update properties of a shape, but mutation into another type is not supported)
     Q_ASSERT(json.contains("type"));
     // VibesGraphicsBoxes has JSON type "boxes union"
     Q_ASSERT(json["type"].toString() == "boxes union");
-    // "bounds" is a matrix
-    Q_ASSERT(isJsonMatrix(json["bounds"]));
+    // Projected bounds
+    const VibesProjection proj = projection(dimX, dimY);
+    const double *lb = proj.column(0), *ub = proj.column(1), *lb2 = proj.column(2), *ub2 = proj.column(3);
+    const int s = proj.stride;
 
     // Update path with projected boxes
     QPainterPath path;
     path.setFillRule(Qt::WindingFill);
 
-    foreach(const QJsonValue value, json["bounds"].toArray())
+    for (int i = 0; i < proj.rows; ++i)
     {
-        const QJsonArray box = value.toArray();
         // Read bounds
-        double lb_x = box[2 * dimX].toDouble();
-        double ub_x = box[2 * dimX + 1].toDouble();
-        double lb_y = box[2 * dimY].toDouble();
-        double ub_y = box[2 * dimY + 1].toDouble();
+        double lb_x = lb[i * s];
+        double ub_x = ub[i * s];
+        double lb_y = lb2[i * s];
+        double ub_y = ub2[i * s];
         // Create a new rect path
         QPainterPath rect_path;
         rect_path.addRect(lb_x, lb_y, ub_x - lb_x, ub_y - lb_y);
@@ -737,8 +1297,8 @@ bool VibesGraphicsEllipse::parseJsonGraphics(const QJsonObject &json)
                 this->_nbDim = center.size();
 
                 // Set graphical properties
-                this->setPen(vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString()));
-                this->setBrush(vibesDefaults.brush(jsonValue("FaceColor").toString()));
+                this->setPen(style().pen);
+                this->setBrush(style().brush);
 
                 // Update successful
                 return true;
@@ -755,8 +1315,9 @@ bool VibesGraphicsEllipse::computeProjection(int dimX, int dimY)
     const QJsonObject & json = this->_json;
 
     // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const VibesStyle & style = this->style();
+    const QBrush & brush = style.brush;
+    const QPen & pen = style.pen;
 
     Q_ASSERT(json.contains("type"));
     Q_ASSERT(json["type"].toString() == "ellipse");
@@ -885,9 +1446,10 @@ bool VibesGraphicsLine::parseJsonGraphics(const QJsonObject &json)
         if (type == "line")
         {
             // Check that the "points" field is a matrix
-            int nbCols, nbRows;
-            if (!isJsonMatrix(json["points"], nbRows, nbCols))
+            const VibesMatrix points = matrix("points");
+            if (points.isEmpty() || points.isVector())
                 return false;
+            int nbCols = points.cols();
             // Number of coordinates has to be at least 2 (to draw in the plane)
             if (nbCols < 2)
                 return 0;
@@ -896,7 +1458,7 @@ bool VibesGraphicsLine::parseJsonGraphics(const QJsonObject &json)
             this->_nbDim = nbCols;
 
             // Set pen
-            this->setPen(vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString()));
+            this->setPen(style().pen);
 
             // Update successful
             return true;
@@ -907,31 +1469,36 @@ bool VibesGraphicsLine::parseJsonGraphics(const QJsonObject &json)
     return false;
 }
 
+bool VibesGraphicsLine::projectionColumns(int dimX, int dimY, QString &key, QVector<int> &columns) const
+{
+    key = "points";
+    columns = QVector<int>() << dimX << dimY;
+    return true;
+}
+
 bool VibesGraphicsLine::computeProjection(int dimX, int dimY)
 {
     const QJsonObject & json = this->_json;
 
     // Get shape color (or default if not specified)
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const QPen pen = style().pen;
 
     // Now process shape-specific properties
     // (we can only update properties of a shape, but mutation into another type is not supported)
     Q_ASSERT(json.contains("type"));
     // VibesGraphicsLine has JSON type "line"
     Q_ASSERT(json["type"].toString() == "line");
-    // "bounds" is a matrix
-    Q_ASSERT(isJsonMatrix(json["points"]));
+    // Projected points
+    const VibesProjection proj = projection(dimX, dimY);
+    const double *xs = proj.column(0), *ys = proj.column(1);
+    const int s = proj.stride;
 
     // Update line with projected points
     QPainterPath path;
-    QPolygonF polygon;
+    QPolygonF polygon(proj.rows);
 
-    foreach(const QJsonValue value, json["points"].toArray())
-    {
-        // Read coordinates and append them to the list of points
-        const QJsonArray coords = value.toArray();
-        polygon << QPointF(coords[dimX].toDouble(), coords[dimY].toDouble());
-    }
+    for (int i = 0; i < proj.rows; ++i)
+        polygon[i] = QPointF(xs[i * s], ys[i * s]);
     // Update polygon with the list of vertices
     path.addPolygon(polygon);
     this->setPath(path);
@@ -955,10 +1522,11 @@ bool VibesGraphicsPolygon::parseJsonGraphics(const QJsonObject &json)
         // VibesGraphicsBox has JSON type "polygon"
         if (type == "polygon")
         {
-            // Check that the "points" field is a matrix
-            int nbCols, nbRows;
-            if (!isJsonMatrix(json["bounds"], nbRows, nbCols))
+            // Check that the "bounds" field is a matrix
+            const VibesMatrix bounds = matrix("bounds");
+            if (bounds.isEmpty() || bounds.isVector())
                 return false;
+            int nbCols = bounds.cols();
             // Number of coordinates has to be at least 2 (to draw in the plane)
             if (nbCols < 2)
                 return 0;
@@ -967,8 +1535,8 @@ bool VibesGraphicsPolygon::parseJsonGraphics(const QJsonObject &json)
             this->_nbDim = nbCols;
 
             // Set pen
-            this->setPen(vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString()));
-            this->setBrush(vibesDefaults.brush(jsonValue("FaceColor").toString()));
+            this->setPen(style().pen);
+            this->setBrush(style().brush);
 
             // Update successful
             return true;
@@ -979,26 +1547,33 @@ bool VibesGraphicsPolygon::parseJsonGraphics(const QJsonObject &json)
     return false;
 }
 
+bool VibesGraphicsPolygon::projectionColumns(int dimX, int dimY, QString &key, QVector<int> &columns) const
+{
+    key = "bounds";
+    columns = QVector<int>() << dimX << dimY;
+    return true;
+}
+
 bool VibesGraphicsPolygon::computeProjection(int dimX, int dimY)
 {
     const QJsonObject & json = this->_json;
 
     // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const VibesStyle & style = this->style();
+    const QBrush & brush = style.brush;
+    const QPen & pen = style.pen;
 
     Q_ASSERT(json.contains("type"));
     Q_ASSERT(json["type"].toString() == "polygon");
 
-    // Update polygon
-    QPolygonF polygon;
+    // Update polygon with projected vertices
+    const VibesProjection proj = projection(dimX, dimY);
+    const double *xs = proj.column(0), *ys = proj.column(1);
+    const int s = proj.stride;
+    QPolygonF polygon(proj.rows);
 
-    foreach(const QJsonValue value, json["bounds"].toArray())
-    {
-        // Read coordinates and append them to the list of points
-        const QJsonArray coords = value.toArray();
-        polygon << QPointF(coords[dimX].toDouble(), coords[dimY].toDouble());
-    }
+    for (int i = 0; i < proj.rows; ++i)
+        polygon[i] = QPointF(xs[i * s], ys[i * s]);
     this->setPolygon(polygon);
 
     // Update polygon color
@@ -1045,8 +1620,9 @@ bool VibesGraphicsText::computeProjection(int dimX, int dimY)
 {
     const QJsonObject & json = this->_json;
     // Get ring color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const VibesStyle & style = this->style();
+    const QBrush & brush = style.brush;
+    const QPen & pen = style.pen;
 
     // Now process shape-specific properties
     // (we can only update properties of a shape, but mutation into another type is not supported)
@@ -1079,6 +1655,298 @@ bool VibesGraphicsText::computeProjection(int dimX, int dimY)
     return true;
 }
 
+void VibesGraphicsText::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    // Text rendering is expensive, skip it in draft mode
+    if (VibesGraphicsItem::scene() && VibesGraphicsItem::scene()->isDraft())
+        return;
+    QGraphicsSimpleTextItem::paint(painter, option, widget);
+}
+
+
+//
+// VibesGlyph
+//
+
+void VibesGlyph::addPart(const QPainterPath &path, VibesGlyphPart::Paint penPaint, VibesGlyphPart::Paint brushPaint,
+                         const QPen &fixedPen, const QBrush &fixedBrush, bool uprightOnly)
+{
+    VibesGlyphPart part;
+    part.path = path;
+    part.penPaint = penPaint;
+    part.brushPaint = brushPaint;
+    part.fixedPen = fixedPen;
+    part.fixedBrush = fixedBrush;
+    part.uprightOnly = uprightOnly;
+    parts.append(part);
+
+    // Pens are in scene units: they are added by the items
+    bounds |= path.controlPointRect();
+    if (penPaint == VibesGlyphPart::FixedPaint)
+        fixedPenWidth = qMax(fixedPenWidth, fixedPen.widthF());
+}
+
+void VibesGlyph::addText(const QString &text, const QTransform &transform, const QPen &pen, VibesGlyphPart::Paint brushPaint, bool uprightOnly)
+{
+    VibesGlyphPart part;
+    part.penPaint = VibesGlyphPart::FixedPaint;
+    part.brushPaint = brushPaint;
+    part.fixedPen = pen;
+    part.uprightOnly = uprightOnly;
+    part.text = text;
+    part.textTransform = transform;
+    parts.append(part);
+
+    const QGraphicsSimpleTextItem label(text);
+    const double margin = pen.widthF() / 2.;
+    bounds |= transform.mapRect(label.boundingRect().adjusted(-margin, -margin, margin, margin));
+}
+
+const VibesGlyph & VibesGlyph::vehicle()
+{
+    // Built once, on first use (thread-safe initialization of a local static)
+    static const VibesGlyph glyph = []() {
+        VibesGlyph glyph;
+        glyph.length = 4.;
+        QPolygonF polygon;
+        polygon << QPointF(-1., 1.) << QPointF(+3., 0.) << QPointF(-1., -1.);
+        QPainterPath body;
+        body.addPolygon(polygon);
+        body.closeSubpath();
+        glyph.addPart(body, VibesGlyphPart::ItemStyle, VibesGlyphPart::ItemStyle);
+        return glyph;
+    }();
+    return glyph;
+}
+
+const VibesGlyph & VibesGlyph::vehicleAUV()
+{
+    /*  This shape is inspired by the MOOS middleware GUI (see pMarineViewer)   */
+    static const VibesGlyph glyph = []() {
+        VibesGlyph glyph;
+        glyph.length = 7.;
+
+        // Body
+        QPolygonF body;
+        body << QPointF(-4., 0.) << QPointF(-2., 1.) << QPointF(2., 1.);
+        for (float i = 90.; i > -90.; i -= 10.) // noise
+            body << QPointF((cos(i * M_PI / 180.0) + 2.), (sin(i * M_PI / 180.0) + 0.));
+        body << QPointF(2., -1.) << QPointF(-2., -1.);
+        QPainterPath bodyPath;
+        bodyPath.addPolygon(body);
+        bodyPath.closeSubpath();
+        glyph.addPart(bodyPath, VibesGlyphPart::ItemStyle, VibesGlyphPart::ItemStyle);
+
+        // Propulsion unit
+        QPainterPath propunit;
+        propunit.addRect(QRectF(QPointF(-4., -1.), QPointF(-3.25, 1.)));
+        glyph.addPart(propunit, VibesGlyphPart::ItemStyle, VibesGlyphPart::ItemStyle);
+        return glyph;
+    }();
+    return glyph;
+}
+
+const VibesGlyph & VibesGlyph::vehicleTank()
+{
+    /*  This shape is inspired by Luc Jaulin   */
+    static const VibesGlyph glyph = []() {
+        VibesGlyph glyph;
+        glyph.length = 4.;
+        QPolygonF body;
+        body << QPointF(1., -1.5) << QPointF(-1., -1.5) << QPointF(0., -1.5) << QPointF(0., -1.)
+             << QPointF(-1., -1.) << QPointF(-1., 1.) << QPointF(0., 1.) << QPointF(0., 1.5)
+             << QPointF(-1., 1.5) << QPointF(1., 1.5) << QPointF(0., 1.5) << QPointF(0., 1.)
+             << QPointF(3., 0.5) << QPointF(3., -0.5) << QPointF(0., -1.) << QPointF(0., -1.5);
+        QPainterPath bodyPath;
+        bodyPath.addPolygon(body);
+        bodyPath.closeSubpath();
+        glyph.addPart(bodyPath, VibesGlyphPart::ItemStyle, VibesGlyphPart::ItemStyle);
+        return glyph;
+    }();
+    return glyph;
+}
+
+const VibesGlyph & VibesGlyph::vehicleMotorBoat()
+{
+    static const VibesGlyph glyph = []() {
+        VibesGlyph glyph;
+        glyph.length = 401.;
+
+        // Body
+        QPolygonF body;
+        body << QPointF(-72,80) << QPointF(120,80) << QPointF(136,79.) << QPointF(152,79)
+             << QPointF(168,78) << QPointF(184,76) << QPointF(200,74) << QPointF(216,71)
+             << QPointF(232,67) << QPointF(248,63) << QPointF(264,57) << QPointF(280,49)
+             << QPointF(296,39) << QPointF(312,24) << QPointF(329,0) << QPointF(312,-24)
+             << QPointF(296,-39) << QPointF(280,-49) << QPointF(264,-57) << QPointF(248,-63)
+             << QPointF(232,-67) << QPointF(216,-71) << QPointF(200,-74) << QPointF(184,-76)
+             << QPointF(168,-78) << QPointF(152,-79) << QPointF(136,-79.) << QPointF(120,-80)
+             << QPointF(-72,-80);
+        QPainterPath bodyPath;
+        bodyPath.addPolygon(body);
+        bodyPath.closeSubpath();
+        glyph.addPart(bodyPath, VibesGlyphPart::ItemStyle, VibesGlyphPart::ItemStyle);
+
+        // Left and right props
+        QPainterPath props;
+        props.addRect(QRectF(QPointF(-80,16), QPointF(-72,48)));
+        props.addRect(QRectF(QPointF(-80,-48), QPointF(-72,-16)));
+        glyph.addPart(props, VibesGlyphPart::ItemStyle, VibesGlyphPart::ItemPenColor);
+
+        // Hull details
+        QPainterPath hull_details;
+        hull_details.moveTo(120, 80);
+        hull_details.lineTo(104, 64);
+        hull_details.lineTo(-56, 64);
+        hull_details.lineTo(-56, -64);
+        hull_details.lineTo(104, -64);
+        hull_details.lineTo(120, -80);
+        glyph.addPart(hull_details, VibesGlyphPart::ItemStyle, VibesGlyphPart::NoPaint);
+
+        // Engine
+        QPainterPath engine;
+        engine.addRect(QRectF(QPointF(-15,-22.5), QPointF(30,22.5)));
+        glyph.addPart(engine, VibesGlyphPart::ItemStyle, VibesGlyphPart::ItemPenColor);
+
+        // Circle
+        QPainterPath circle;
+        circle.addEllipse(QRectF(200-24, -24, 48, 48));
+        glyph.addPart(circle, VibesGlyphPart::ItemStyle, VibesGlyphPart::NoPaint);
+        return glyph;
+    }();
+    return glyph;
+}
+
+const VibesGlyph & VibesGlyph::cake()
+{
+    static const VibesGlyph glyph = []() {
+        VibesGlyph glyph;
+        // The cake is drawn for a unit length. Its pens keep the widths of the original
+        // drawing: fixed in scene units, and the item pen divided by the cake length.
+        glyph.length = 1.;
+        glyph.penLength = 7.;
+        const QBrush cake_brush(QColor("#ffde85"));
+        const QBrush cream_brush(QColor("#fcf7e8"));
+        const QPen cake_pen(QBrush(Qt::black), 0.1);
+        const QPen text_pen(QBrush(QColor("#525252")), 0.5);
+
+        // Layers
+        QPainterPath bottom;
+        bottom.addEllipse(QRectF(-0.5, -0.125, 1., 0.25));
+        glyph.addPart(bottom, VibesGlyphPart::FixedPaint, VibesGlyphPart::FixedPaint, cake_pen, cake_brush);
+        QPainterPath body;
+        body.addRect(QRectF(-0.5, 0., 1., 0.5));
+        glyph.addPart(body, VibesGlyphPart::NoPaint, VibesGlyphPart::FixedPaint, QPen(), cake_brush);
+        // (overlapping shapes are separate parts: a single path would leave holes)
+        QPainterPath cream;
+        cream.addEllipse(QRectF(-0.5, 0.25, 1., 0.25));
+        glyph.addPart(cream, VibesGlyphPart::NoPaint, VibesGlyphPart::FixedPaint, QPen(), cream_brush);
+        QPainterPath creamSide;
+        creamSide.addRect(QRectF(-0.5, 0.375, 1., 0.125));
+        glyph.addPart(creamSide, VibesGlyphPart::NoPaint, VibesGlyphPart::FixedPaint, QPen(), cream_brush);
+
+        // Sides
+        QPainterPath sides;
+        sides.moveTo(-0.5, 0.);
+        sides.lineTo(-0.5, 0.5);
+        sides.moveTo(0.5, 0.);
+        sides.lineTo(0.5, 0.5);
+        glyph.addPart(sides, VibesGlyphPart::FixedPaint, VibesGlyphPart::NoPaint, cake_pen);
+
+        // Top
+        QPainterPath top;
+        top.addEllipse(QRectF(-0.5, 0.375, 1., 0.25));
+        glyph.addPart(top, VibesGlyphPart::FixedPaint, VibesGlyphPart::FixedPaint, cake_pen, cream_brush);
+
+        // Candles, the label is drawn over the first four
+        QPainterPath candles;
+        candles.addEllipse(QRectF(-0.5, 0.4375, 0.125, 0.125));
+        candles.addEllipse(QRectF(0.375, 0.4375, 0.125, 0.125));
+        candles.addEllipse(QRectF(-0.25, 0.5625, 0.125, 0.125));
+        candles.addEllipse(QRectF(0.125, 0.5625, 0.125, 0.125));
+        glyph.addPart(candles, VibesGlyphPart::ItemStyle, VibesGlyphPart::ItemStyle);
+
+        // Label, upside up
+        glyph.addText("10", QTransform(0.04, 0., 0., -0.04, -0.375, 1.), text_pen, VibesGlyphPart::ItemStyle, true);
+
+        QPainterPath frontCandles;
+        frontCandles.addEllipse(QRectF(-0.25, 0.375, 0.125, 0.125));
+        frontCandles.addEllipse(QRectF(0.125, 0.375, 0.125, 0.125));
+        glyph.addPart(frontCandles, VibesGlyphPart::ItemStyle, VibesGlyphPart::ItemStyle);
+        return glyph;
+    }();
+    return glyph;
+}
+
+bool VibesGlyphInstance::place(const VibesGlyph &glyph, const QJsonObject &json, int dimX, int dimY, double penWidth)
+{
+    const QJsonArray center = json["center"].toArray();
+    const double length = json["length"].toDouble();
+    const double orientation = json["orientation"].toDouble();
+    if (center.size() <= qMax(dimX, dimY) || length <= 0.)
+        return false;
+
+    // Glyph units to scene: scaled to the length, turned by the orientation, moved to the center
+    this->glyph = &glyph;
+    scale = length / glyph.length;
+    upright = (orientation == 0.);
+    transform = QTransform();
+    transform.translate(center[dimX].toDouble(), center[dimY].toDouble());
+    transform.rotate(orientation);
+    transform.scale(scale, scale);
+
+    this->penWidth = glyph.penLength > 0. ? penWidth * glyph.penLength / length : penWidth;
+    const double margin = qMax(this->penWidth, glyph.fixedPenWidth) / 2.;
+    bounds = transform.mapRect(glyph.bounds).adjusted(-margin, -margin, margin, margin);
+    return true;
+}
+
+void VibesGlyphInstance::paint(QPainter *painter, const QPen &pen, const QBrush &brush) const
+{
+    if (!glyph)
+        return;
+    painter->setTransform(transform, true);
+
+    // Parts are drawn in glyph units, pens are given in scene units
+    QPen itemPen = pen;
+    itemPen.setWidthF(penWidth / scale);
+    foreach (const VibesGlyphPart &part, glyph->parts)
+    {
+        if (part.uprightOnly && !upright)
+            continue;
+        QBrush partBrush;
+        switch (part.brushPaint)
+        {
+        case VibesGlyphPart::ItemStyle: partBrush = brush; break;
+        case VibesGlyphPart::ItemPenColor: partBrush = pen.color(); break;
+        case VibesGlyphPart::FixedPaint: partBrush = part.fixedBrush; break;
+        default: break;
+        }
+        if (!part.text.isEmpty())
+        {
+            QGraphicsSimpleTextItem label(part.text);
+            label.setPen(part.fixedPen);
+            label.setBrush(partBrush);
+            QStyleOptionGraphicsItem option;
+            option.exposedRect = label.boundingRect();
+            painter->save();
+            painter->setTransform(part.textTransform, true);
+            label.paint(painter, &option, 0);
+            painter->restore();
+            continue;
+        }
+        QPen fixedPen = part.fixedPen;
+        switch (part.penPaint)
+        {
+        case VibesGlyphPart::ItemStyle: painter->setPen(itemPen); break;
+        case VibesGlyphPart::FixedPaint: fixedPen.setWidthF(fixedPen.widthF() / scale); painter->setPen(fixedPen); break;
+        default: painter->setPen(Qt::NoPen); break;
+        }
+        painter->setBrush(partBrush);
+        painter->drawPath(part.path);
+    }
+}
+
 
 //
 // VibesGraphicsVehicle
@@ -1115,67 +1983,6 @@ bool VibesGraphicsVehicle::parseJsonGraphics(const QJsonObject &json)
     return false;
 }
 
-bool VibesGraphicsVehicle::computeProjection(int dimX, int dimY)
-{
-    const QJsonObject & json = this->_json;
-
-    QJsonArray center = json["center"].toArray();
-    double length = json["length"].toDouble();
-    double orientation = json["orientation"].toDouble();
-    
-    // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),QString::number(4.0*jsonValue("LineWidth").toString().toDouble()/length));
-
-    Q_ASSERT(json.contains("type"));
-    Q_ASSERT(json["type"].toString() == "vehicle");
-
-    Q_ASSERT(center.size() == 2);
-    Q_ASSERT(this->_nbDim == center.size());
-    Q_ASSERT(length > 0.);
-
-    // Get center
-    const QPointF & centerPoint = QPointF(center[dimX].toDouble(), center[dimY].toDouble());
-
-    // If the shape has already been drawn, it has at least one child
-    // Update child items if they exist
-    if (this->childItems().size() > 0)
-    {
-        foreach(QGraphicsItem * item, this->childItems())
-        {
-            //to vibes graphics item
-            QGraphicsPolygonItem *graphics_polygon = qgraphicsitem_cast<QGraphicsPolygonItem *>(item);
-            graphics_polygon->setPen(pen);
-            graphics_polygon->setBrush(brush);
-            graphics_polygon->setTransformOriginPoint(centerPoint);
-            graphics_polygon->setRotation(orientation);
-            graphics_polygon->setScale(length / 4.); // initial vehicle's length is 4
-        }
-    }
-    // Else draw the shape for the first time
-    else{
-
-        // Set polygon shape
-        QPolygonF polygon;
-        polygon << QPointF(-1., 1.) + centerPoint;
-        polygon << QPointF(+3., 0.) + centerPoint;
-        polygon << QPointF(-1., -1.) + centerPoint;
-
-
-        // Draw with the new properties
-        QGraphicsPolygonItem *graphics_polygon = new QGraphicsPolygonItem(polygon);
-        graphics_polygon->setPen(pen);
-        graphics_polygon->setBrush(brush);
-        graphics_polygon->setTransformOriginPoint(centerPoint);
-        graphics_polygon->setRotation(orientation);
-        graphics_polygon->setScale(length / 4.); // initial vehicle's length is 4
-        this->addToGroup(graphics_polygon);
-    }
-
-    // Update successful
-    return true;
-}
-
 
 //
 // VibesGraphicsVehicleAUV
@@ -1212,98 +2019,6 @@ bool VibesGraphicsVehicleAUV::parseJsonGraphics(const QJsonObject &json)
     return false;
 }
 
-bool VibesGraphicsVehicleAUV::computeProjection(int dimX, int dimY)
-{
-    const QJsonObject & json = this->_json;
-
-    QJsonArray center = json["center"].toArray();
-    double length = json["length"].toDouble();
-    double orientation = json["orientation"].toDouble();
-
-    // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(), QString::number(7.0*jsonValue("LineWidth").toString().toDouble()/length));
-
-    Q_ASSERT(json.contains("type"));
-    Q_ASSERT(json["type"].toString() == "vehicle_auv");
-
-    Q_ASSERT(center.size() == 2);
-    Q_ASSERT(this->_nbDim == center.size());
-    Q_ASSERT(length > 0.);
-
-    // Get center
-    const QPointF & centerPoint = QPointF(center[dimX].toDouble(), center[dimY].toDouble());
-
-    /*  This shape is inspired by the MOOS middleware GUI (see pMarineViewer)   */
-
-    // If the shape has already been drawn, it has at least one child
-    // Update child items if they exist
-    if (this->childItems().size() > 0)
-    {
-        foreach(QGraphicsItem * item, this->childItems())
-        {
-            //to vibes graphics item
-            QGraphicsPolygonItem *graphics_polygon = qgraphicsitem_cast<QGraphicsPolygonItem *>(item);
-            graphics_polygon->setPen(pen);
-            graphics_polygon->setBrush(brush);
-            graphics_polygon->setTransformOriginPoint(centerPoint);
-            graphics_polygon->setRotation(orientation);
-            graphics_polygon->setScale(length / 7.); // initial vehicle's length is 7
-        }
-    }
-    // Else draw the shape for the first time
-    else{
-        // Set body shape
-        {
-            QPolygonF body;
-            body << QPointF(-4., 0.) + centerPoint;
-            body << QPointF(-2., 1.) + centerPoint;
-            body << QPointF(2., 1.) + centerPoint;
-
-            for (float i = 90.; i > -90.; i -= 10.) // noise
-                body << QPointF((cos(i * M_PI / 180.0) + 2.),
-                                (sin(i * M_PI / 180.0) + 0.)) + centerPoint;
-
-            body << QPointF(2., -1.) + centerPoint;
-            body << QPointF(-2., -1.) + centerPoint;
-
-
-            // Draw with the new properties
-            QGraphicsPolygonItem *graphics_body = new QGraphicsPolygonItem(body);
-            graphics_body->setPen(pen);
-            graphics_body->setBrush(brush);
-            graphics_body->setTransformOriginPoint(centerPoint);
-            graphics_body->setRotation(orientation);
-            graphics_body->setScale(length / 7.); // initial vehicle's length is 7
-            this->addToGroup(graphics_body);
-            graphics_body->setPen(pen);
-        }
-
-        // Set propulsion unit shape
-        {
-            QPolygonF propunit;
-            propunit << QPointF(-4., 1) + centerPoint;
-            propunit << QPointF(-3.25, 1) + centerPoint;
-            propunit << QPointF(-3.25, -1) + centerPoint;
-            propunit << QPointF(-4., -1) + centerPoint;
-
-            // Draw with the new properties
-            QGraphicsPolygonItem *graphics_propunit = new QGraphicsPolygonItem(propunit);
-            graphics_propunit->setPen(pen);
-            graphics_propunit->setBrush(brush);
-            graphics_propunit->setTransformOriginPoint(centerPoint);
-            graphics_propunit->setRotation(orientation);
-            graphics_propunit->setScale(length / 7.); // initial vehicle's length is 7
-            this->addToGroup(graphics_propunit);
-        }
-    }
-
-
-
-    // Update successful
-    return true;
-}
-
 
 //
 // VibesGraphicsVehicleTank
@@ -1339,85 +2054,6 @@ bool VibesGraphicsVehicleTank::parseJsonGraphics(const QJsonObject &json)
     // Unknown or empty JSON, update failed
     return false;
 }
-#include <iostream>
-bool VibesGraphicsVehicleTank::computeProjection(int dimX, int dimY)
-{
-    const QJsonObject & json = this->_json;
-
-    QJsonArray center = json["center"].toArray();
-    double length = json["length"].toDouble();
-    double orientation = json["orientation"].toDouble();
-
-    // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),QString::number(4.0*jsonValue("LineWidth").toString().toDouble()/length));
-
-    Q_ASSERT(json.contains("type"));
-    Q_ASSERT(json["type"].toString() == "vehicle_tank");
-
-    Q_ASSERT(center.size() == 2);
-    Q_ASSERT(this->_nbDim == center.size());
-    Q_ASSERT(length > 0.);
-
-    // Get center
-    const QPointF & centerPoint = QPointF(center[dimX].toDouble(), center[dimY].toDouble());
-
-    /*  This shape is inspired by Luc Jaulin   */
-
-    // If the shape has already been drawn, it has at least one child
-    // Update child items if they exist
-    if (this->childItems().size() > 0)
-    {
-        foreach(QGraphicsItem * item, this->childItems())
-        {
-            //to vibes graphics item
-            QGraphicsPolygonItem *graphics_polygon = qgraphicsitem_cast<QGraphicsPolygonItem *>(item);
-            graphics_polygon->setPen(pen);
-            graphics_polygon->setBrush(brush);
-            graphics_polygon->setTransformOriginPoint(centerPoint);
-            graphics_polygon->setRotation(orientation);
-            graphics_polygon->setScale(length / 4.); // initial vehicle's length is 4
-        }
-    }
-    // Else draw the shape for the first time
-    else{
-
-        // Set body shape
-        {
-            QPolygonF body;
-            body << QPointF(1., -1.5) + centerPoint;
-            body << QPointF(-1., -1.5) + centerPoint;
-            body << QPointF(0., -1.5) + centerPoint;
-            body << QPointF(0., -1.) + centerPoint;
-            body << QPointF(-1., -1.) + centerPoint;
-            body << QPointF(-1., 1.) + centerPoint;
-            body << QPointF(0., 1.) + centerPoint;
-            body << QPointF(0., 1.5) + centerPoint;
-            body << QPointF(-1., 1.5) + centerPoint;
-            body << QPointF(1., 1.5) + centerPoint;
-            body << QPointF(0., 1.5) + centerPoint;
-            body << QPointF(0., 1.) + centerPoint;
-            body << QPointF(3., 0.5) + centerPoint;
-            body << QPointF(3., -0.5) + centerPoint;
-            body << QPointF(0., -1.) + centerPoint;
-            body << QPointF(0., -1.5) + centerPoint;
-
-
-            // Draw with the new properties
-            QGraphicsPolygonItem *graphics_body = new QGraphicsPolygonItem(body);
-            graphics_body->setPen(pen);
-            graphics_body->setBrush(brush);
-            graphics_body->setTransformOriginPoint(centerPoint);
-            graphics_body->setRotation(orientation);
-
-            graphics_body->setScale(length/4.); // initial vehicle's length is 4
-            this->addToGroup(graphics_body);
-        }
-    }
-
-    // Update successful
-    return true;
-}
 
 
 //
@@ -1455,192 +2091,6 @@ bool VibesGraphicsVehicleMotorBoat::parseJsonGraphics(const QJsonObject &json)
     return false;
 }
 
-bool VibesGraphicsVehicleMotorBoat::computeProjection(int dimX, int dimY)
-{
-    const QJsonObject & json = this->_json;
-
-    QJsonArray center = json["center"].toArray();
-    double length = json["length"].toDouble();
-    double orientation = json["orientation"].toDouble();
-
-    // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),QString::number(401.0*jsonValue("LineWidth").toString().toDouble()/length));
-
-    Q_ASSERT(json.contains("type"));
-    Q_ASSERT(json["type"].toString() == "vehicle_motor_boat");
-
-    Q_ASSERT(center.size() == 2);
-    Q_ASSERT(this->_nbDim == center.size());
-    Q_ASSERT(length > 0.);
-
-    // Get center
-    const QPointF & centerPoint = QPointF(center[dimX].toDouble(), center[dimY].toDouble());
-
-    // If the shape has already been drawn, it has at least one child
-    // Update child items if they exist
-    if (this->childItems().size() > 0)
-    {
-        foreach(QGraphicsItem * item, this->childItems())
-        {
-            if (item->type() == QGraphicsPathItem::Type)
-            {
-                //to vibes graphics item
-                QGraphicsPathItem *graphics_path = qgraphicsitem_cast<QGraphicsPathItem *>(item);
-                graphics_path->setPen(pen);
-                graphics_path->setBrush(brush);
-            }
-            else if (item->type() == QGraphicsPolygonItem::Type)
-            {
-                //to vibes graphics item
-                QGraphicsPolygonItem *graphics_polygon = qgraphicsitem_cast<QGraphicsPolygonItem *>(item);
-                graphics_polygon->setPen(pen);
-                graphics_polygon->setBrush(brush);
-            }
-            else if (item->type() == QGraphicsEllipseItem::Type)
-            {
-                //to vibes graphics item
-                QGraphicsEllipseItem *graphics_ellipse = qgraphicsitem_cast<QGraphicsEllipseItem *>(item);
-                graphics_ellipse->setPen(pen);
-                graphics_ellipse->setBrush(brush);
-            }
-        }
-    }
-    // Else draw the shape for the first time
-    else{
-
-        // Set body shape
-        {
-            QPolygonF body;
-            body << QPointF(-72,80) + centerPoint;
-            body << QPointF(120,80) + centerPoint;
-            body << QPointF(136,79.) + centerPoint;
-            body << QPointF(152,79) + centerPoint;
-            body << QPointF(168,78) + centerPoint;
-            body << QPointF(184,76) + centerPoint;
-            body << QPointF(200,74) + centerPoint;
-            body << QPointF(216,71) + centerPoint;
-            body << QPointF(232,67) + centerPoint;
-            body << QPointF(248,63) + centerPoint;
-            body << QPointF(264,57) + centerPoint;
-            body << QPointF(280,49) + centerPoint;
-            body << QPointF(296,39) + centerPoint;
-            body << QPointF(312,24) + centerPoint;
-            body << QPointF(329,0) + centerPoint;
-            body << QPointF(312,-24) + centerPoint;
-            body << QPointF(296,-39) + centerPoint;
-            body << QPointF(280,-49) + centerPoint;
-            body << QPointF(264,-57) + centerPoint;
-            body << QPointF(248,-63) + centerPoint;
-            body << QPointF(232,-67) + centerPoint;
-            body << QPointF(216,-71) + centerPoint;
-            body << QPointF(200,-74) + centerPoint;
-            body << QPointF(184,-76) + centerPoint;
-            body << QPointF(168,-78) + centerPoint;
-            body << QPointF(152,-79) + centerPoint;
-            body << QPointF(136,-79.) + centerPoint;
-            body << QPointF(120,-80) + centerPoint;
-            body << QPointF(-72,-80) + centerPoint;
-
-            QGraphicsPolygonItem *graphics_body = new QGraphicsPolygonItem(body);
-            graphics_body->setPen(pen);
-            graphics_body->setBrush(brush);
-            graphics_body->setTransformOriginPoint(centerPoint);
-            graphics_body->setRotation(orientation);
-
-            graphics_body->setScale(length/401.);
-            this->addToGroup(graphics_body);
-        }
-
-        // Left prop
-        {
-            QPolygonF left_prop;
-            left_prop << QPointF(-80,48) + centerPoint;
-            left_prop << QPointF(-72,48) + centerPoint;
-            left_prop << QPointF(-72,16) + centerPoint;
-            left_prop << QPointF(-80,16) + centerPoint;
-
-            QGraphicsPolygonItem *graphics_left_prop = new QGraphicsPolygonItem(left_prop);
-            graphics_left_prop->setPen(pen);
-            graphics_left_prop->setBrush(QBrush(pen.color()));
-            graphics_left_prop->setTransformOriginPoint(centerPoint);
-            graphics_left_prop->setRotation(orientation);
-
-            graphics_left_prop->setScale(length/401.);
-            this->addToGroup(graphics_left_prop);
-        }
-
-        // Right prop
-        {
-            QPolygonF right_prop;
-            right_prop << QPointF(-80,-16) + centerPoint;
-            right_prop << QPointF(-72,-16) + centerPoint;
-            right_prop << QPointF(-72,-48) + centerPoint;
-            right_prop << QPointF(-80,-48) + centerPoint;
-
-            QGraphicsPolygonItem *graphics_right_prop = new QGraphicsPolygonItem(right_prop);
-            graphics_right_prop->setPen(pen);
-            graphics_right_prop->setBrush(QBrush(pen.color()));
-            graphics_right_prop->setTransformOriginPoint(centerPoint);
-            graphics_right_prop->setRotation(orientation);
-
-            graphics_right_prop->setScale(length/401.);
-            this->addToGroup(graphics_right_prop);
-        }
-        
-        // Hull details
-        {
-            QPainterPath hull_details;
-            hull_details.moveTo(120 + centerPoint.x(), 80 + centerPoint.y());
-            hull_details.lineTo(104 + centerPoint.x(), 64 + centerPoint.y());
-            hull_details.lineTo(-56 + centerPoint.x(), 64 + centerPoint.y());
-            hull_details.lineTo(-56 + centerPoint.x(), -64 + centerPoint.y());
-            hull_details.lineTo(104 + centerPoint.x(), -64 + centerPoint.y());
-            hull_details.lineTo(120 + centerPoint.x(), -80 + centerPoint.y());
-
-            QGraphicsPathItem *graphics_hull_details = new QGraphicsPathItem(hull_details);
-            graphics_hull_details->setPen(pen);
-            graphics_hull_details->setTransformOriginPoint(centerPoint);
-            graphics_hull_details->setRotation(orientation);
-
-            graphics_hull_details->setScale(length/401.);
-            this->addToGroup(graphics_hull_details);
-        }
-
-        // Engine
-        {
-            QPolygonF engine;
-            engine << QPointF(-15,22.5) + centerPoint;
-            engine << QPointF(30,22.5) + centerPoint;
-            engine << QPointF(30,-22.5) + centerPoint;
-            engine << QPointF(-15,-22.5) + centerPoint;
-
-            QGraphicsPolygonItem *graphics_engine = new QGraphicsPolygonItem(engine);
-            graphics_engine->setPen(pen);
-            graphics_engine->setBrush(QBrush(pen.color()));
-            graphics_engine->setTransformOriginPoint(centerPoint);
-            graphics_engine->setRotation(orientation);
-
-            graphics_engine->setScale(length/401.);
-            this->addToGroup(graphics_engine);
-        }
-
-        // Circle
-        {
-            QGraphicsEllipseItem *circle_item = new QGraphicsEllipseItem(centerPoint.x()-24+200, centerPoint.y()-24, 48, 48);
-            circle_item->setPen(pen);
-            circle_item->setTransformOriginPoint(centerPoint);
-            circle_item->setRotation(orientation);
-
-            circle_item->setScale(length/401.);
-            this->addToGroup(circle_item);
-        }
-    }
-
-    // Update successful
-    return true;
-}
-
 
 //
 // VibesGraphicsArrow
@@ -1685,8 +2135,9 @@ bool VibesGraphicsArrow::computeProjection(int dimX, int dimY)
     const QJsonObject & json = this->_json;
 
     // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const VibesStyle & style = this->style();
+    const QBrush & brush = style.brush;
+    const QPen & pen = style.pen;
 
     // Now process shape-specific properties
     // (we can only update properties of a shape, but mutation into another type is not supported)
@@ -1772,23 +2223,586 @@ bool VibesGraphicsArrow::computeProjection(int dimX, int dimY)
             tip << QPointF(x - cos(-tip_angle + arrow_angle) * tip_length,
                         y - sin(-tip_angle + arrow_angle) * tip_length);
 
-            QGraphicsPolygonItem *graphics_tip = new QGraphicsPolygonItem(tip);
-            graphics_tip->setPen(pen);
-            graphics_tip->setBrush(brush);
-            this->addToGroup(graphics_tip);
+            QGraphicsPolygonItem *graphics_tip = new QGraphicsPolygonItem(tip);
+            graphics_tip->setPen(pen);
+            graphics_tip->setBrush(brush);
+            this->addToGroup(graphics_tip);
+        }
+    }
+
+    // Update successful
+    return true;
+}
+
+
+//
+// VibesGraphicsArrows
+//
+
+bool VibesGraphicsArrows::parseJsonGraphics(const QJsonObject &json)
+{
+    // Now process shape-specific properties
+    // (we can only update properties of a shape, but mutation into another type is not supported)
+    if (json.contains("type"))
+    {
+        // Retrieve type
+        QString type = json["type"].toString();
+
+        // VibesGraphicsArrows has JSON type "arrows"
+        if (type == "arrows")
+        {
+            // One vector per origin, of the same dimension
+            const VibesMatrix origins = matrix("origins");
+            const VibesMatrix vectors = matrix("vectors");
+            if (origins.isEmpty() || origins.rows() != vectors.rows() || origins.cols() != vectors.cols())
+                return false;
+            this->_nbDim = origins.cols();
+
+            // Update successful
+            return true;
+        }
+    }
+
+    // Unknown or empty JSON, update failed
+    return false;
+}
+
+bool VibesGraphicsArrows::computeProjection(int dimX, int dimY)
+{
+    const QJsonObject & json = this->_json;
+
+    // Get shape color (or default if not specified)
+    const VibesStyle & style = this->style();
+
+    // Now process shape-specific properties
+    // (we can only update properties of a shape, but mutation into another type is not supported)
+    Q_ASSERT(json.contains("type"));
+    // VibesGraphicsArrows has JSON type "arrows"
+    Q_ASSERT(json["type"].toString() == "arrows");
+
+    const VibesMatrix origins = matrix("origins");
+    const VibesMatrix vectors = matrix("vectors");
+    const int count = origins.rows();
+    // Same tip for all arrows (by default, proportional to the arrow length)
+    const double tipLength = json["tip_length"].toDouble(0.);
+    const double tipAngle = 160. * M_PI / 180.0;
+
+    _shafts.resize(count);
+    _tips.resize(4 * count);
+    _arrowBounds.resize(count);
+    QVector<double> magnitudes(count);
+    QRectF bounds;
+    for (int i = 0; i < count; ++i)
+    {
+        const double *o = origins.row(i), *v = vectors.row(i);
+        const QPointF start(o[dimX], o[dimY]);
+        const QPointF end(o[dimX] + v[dimX], o[dimY] + v[dimY]);
+        magnitudes[i] = sqrt(v[dimX] * v[dimX] + v[dimY] * v[dimY]);
+        _shafts[i] = QLineF(start, end);
+
+        // Tip, as drawn by an arrow
+        const double length = (tipLength > 0.) ? tipLength : 0.2 * magnitudes[i];
+        const double angle = atan2(-v[dimY], -v[dimX]);
+        QPointF *tip = _tips.data() + 4 * i;
+        tip[0] = end;
+        tip[1] = end - QPointF(cos(tipAngle + angle), sin(tipAngle + angle)) * length;
+        tip[2] = end + QPointF(cos(angle), sin(angle)) * length * 2. / 3.;
+        tip[3] = end - QPointF(cos(-tipAngle + angle), sin(-tipAngle + angle)) * length;
+
+        // Bounds of the shaft and tip (the tip middle point lies inside them)
+        double xmin = qMin(start.x(), end.x()), xmax = qMax(start.x(), end.x());
+        double ymin = qMin(start.y(), end.y()), ymax = qMax(start.y(), end.y());
+        xmin = qMin(xmin, qMin(tip[1].x(), tip[3].x())); xmax = qMax(xmax, qMax(tip[1].x(), tip[3].x()));
+        ymin = qMin(ymin, qMin(tip[1].y(), tip[3].y())); ymax = qMax(ymax, qMax(tip[1].y(), tip[3].y()));
+        _arrowBounds[i] = QRectF(QPointF(xmin, ymin), QPointF(xmax, ymax));
+        bounds = (i == 0) ? _arrowBounds[i] : bounds.united(_arrowBounds[i]);
+    }
+
+    // Color by magnitude, in one pass over all arrows
+    _colors.clear();
+    if (json.contains("ColorMap") && count > 0)
+    {
+        VibesColorMap colorMap;
+        VibesColorMap::fromJson(json["ColorMap"], colorMap);
+        _colors.resize(count);
+        colorMap.map(magnitudes.constData(), count, json["ColorRange"], _colors.data());
+    }
+
+    this->prepareGeometryChange();
+    // Margin for the pen width
+    const double margin = style.pen.widthF() / 2.;
+    _boundingRect = bounds.adjusted(-margin, -margin, margin, margin);
+
+    this->setPen(style.pen);
+    this->setBrush(style.brush);
+    // Only repaint the exposed arrows
+    this->setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+
+    // Update successful
+    return count > 0;
+}
+
+void VibesGraphicsArrows::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+{
+    const QRectF exposed = option->exposedRect;
+    QPen pen = paintPen(this->pen());
+    painter->setPen(pen);
+    painter->setBrush(brush());
+
+    // Single color: visible shafts are drawn in one call
+    if (_colors.isEmpty())
+    {
+        QVector<QLineF> shafts;
+        QVector<int> visible;
+        shafts.reserve(_shafts.size());
+        visible.reserve(_shafts.size());
+        for (int i = 0; i < _shafts.size(); ++i)
+        {
+            if (_arrowBounds.at(i).intersects(exposed) || exposed.contains(_shafts.at(i).p1()))
+            {
+                shafts.append(_shafts.at(i));
+                visible.append(i);
+            }
+        }
+        painter->drawLines(shafts);
+        foreach (int i, visible)
+            painter->drawPolygon(_tips.constData() + 4 * i, 4);
+        return;
+    }
+
+    // Colored by magnitude
+    for (int i = 0; i < _shafts.size(); ++i)
+    {
+        if (!_arrowBounds.at(i).intersects(exposed) && !exposed.contains(_shafts.at(i).p1()))
+            continue;
+        const QColor color = QColor::fromRgba(_colors.at(i));
+        pen.setColor(color);
+        painter->setPen(pen);
+        painter->setBrush(color);
+        painter->drawLine(_shafts.at(i));
+        painter->drawPolygon(_tips.constData() + 4 * i, 4);
+    }
+}
+
+//
+// VibesGraphicsPie
+//
+
+bool VibesGraphicsPie::parseJsonGraphics(const QJsonObject &json)
+{
+    // Now process shape-specific properties
+    // (we can only update properties of a shape, but mutation into another type is not supported)
+    if (json.contains("type"))
+    {
+        // Retrieve type
+        QString type = json["type"].toString();
+
+        // VibesGraphicsPie has JSON type "pie"
+        if (type == "pie" && json.contains("center"))
+        {
+            QJsonArray center = json["center"].toArray();
+            if (center.size() != 2) return false;
+            if (json.contains("rho"))
+            {
+                if (json["rho"].toArray().size() != 2) return false;
+            }
+            else if (json.contains("theta"))
+            {
+                if (json["theta"].toArray().size() != 2) return false;
+            }
+            // Compute dimension
+            this->_nbDim = center.size();
+
+            // Update successful
+            return true;
+        }
+    }
+
+    // Unknown or empty JSON, update failed
+    return false;
+}
+
+bool VibesGraphicsPie::computeProjection(int dimX, int dimY)
+{
+    const QJsonObject & json = this->_json;
+
+    // Get shape color (or default if not specified)
+    const VibesStyle & style = this->style();
+    const QBrush & brush = style.brush;
+    const QPen & pen = style.pen;
+
+    // Now process shape-specific properties
+    // (we can only update properties of a shape, but mutation into another type is not supported)
+    Q_ASSERT(json.contains("type"));
+    // VibesGraphicsPie has JSON type "pie"
+    Q_ASSERT(json["type"].toString() == "pie");
+
+    QJsonArray center = json["center"].toArray();
+    QJsonArray rho = json["rho"].toArray();
+    QJsonArray theta = json["theta"].toArray();
+
+    Q_ASSERT(rho[0].toDouble() >= 0);
+    Q_ASSERT(rho[1].toDouble() >= rho[0].toDouble());
+
+    // If the shape has already been drawn, it has at least one child
+    // Update child items if they exist
+    if (this->childItems().size() > 0)
+    {
+        foreach(QGraphicsItem * item, this->childItems())
+        {
+            //to vibes graphics item
+            QGraphicsPathItem *graphics_polygon = qgraphicsitem_cast<QGraphicsPathItem *>(item);
+            graphics_polygon->setPen(pen);
+            graphics_polygon->setBrush(brush);
+        }
+    }
+    // Else draw the shape for the first time
+    else{
+        // Body
+        {
+
+            double cx = center[0].toDouble();
+            double cy = center[1].toDouble();
+
+            double rho_m = rho[0].toDouble();
+            double rho_p = rho[1].toDouble();
+            double theta_m = -theta[0].toDouble();
+            double theta_p = -theta[1].toDouble();
+
+            // Angles are in degree and in clock-wise
+            double m1_x = cx + rho_m * std::cos(-theta_m * M_PI / 180.0);
+            double m1_y = cy + rho_m * std::sin(-theta_m * M_PI / 180.0);
+
+            double m2_x = cx + rho_m * std::cos(-theta_p * M_PI / 180.0);
+            double m2_y = cy + rho_m * std::sin(-theta_p * M_PI / 180.0);
+
+            double m4_x = cx + rho_p * std::cos(-theta_m * M_PI / 180.0);
+            double m4_y = cy + rho_p * std::sin(-theta_m * M_PI / 180.0);
+
+            double dtheta = theta_p - theta_m;
+
+            QPainterPath path(QPointF(m1_x, m1_y));
+            path.lineTo(m4_x, m4_y);
+            path.arcTo(QRectF(QPointF(cx - rho_p, cy - rho_p), QPointF(cx + rho_p, cy + rho_p)), theta_m, dtheta);
+            path.lineTo(m2_x, m2_y);
+            path.arcTo(QRectF(QPointF(cx - rho_m, cy - rho_m), QPointF(cx + rho_m, cy + rho_m)), theta_p, -dtheta);
+
+            // Draw with the new properties
+            QGraphicsPathItem *graphics_path = new QGraphicsPathItem(path);
+            graphics_path->setPen(pen);
+            graphics_path->setBrush(brush);
+            this->addToGroup(graphics_path);
+
+        }
+    }
+
+    // Update successful
+    return true;
+}
+
+//
+// VibesGraphicsPolylines
+//
+
+bool VibesGraphicsPolylines::parseJsonGraphics(const QJsonObject &json)
+{
+    // Now process shape-specific properties
+    // (we can only update properties of a shape, but mutation into another type is not supported)
+    if (json.contains("type"))
+    {
+        // Retrieve type
+        QString type = json["type"].toString();
+
+        // VibesGraphicsPolylines has JSON type "lines" or "polygons"
+        if (type == "lines" || type == "polygons")
+        {
+            // Flat coordinates of points of the given dimension, and offsets (in points) of each polyline
+            const int dim = json.contains("dimension") ? json["dimension"].toInt() : 2;
+            const VibesMatrix coordinates = matrix("coordinates");
+            const VibesMatrix offsets = matrix("offsets");
+            if (dim < 2 || !coordinates.isVector() || coordinates.cols() % dim != 0) return false;
+            if (!offsets.isVector() || offsets.cols() < 2) return false;
+            // Offsets are point indices: integers, increasing from 0 to at most the number of points
+            const int nbPoints = coordinates.cols() / dim;
+            const double *o = offsets.row(0);
+            for (int i = 0; i < offsets.cols(); ++i)
+                if (!std::isfinite(o[i]) || o[i] != std::floor(o[i])) return false;
+            if (o[0] < 0 || o[offsets.cols() - 1] > nbPoints) return false;
+            for (int i = 1; i < offsets.cols(); ++i)
+                if (o[i] < o[i - 1]) return false;
+            _closed = (type == "polygons");
+            // Set dimension
+            this->_nbDim = dim;
+
+            // Update successful
+            return true;
+        }
+    }
+
+    // Unknown or empty JSON, update failed
+    return false;
+}
+
+bool VibesGraphicsPolylines::computeProjection(int dimX, int dimY)
+{
+    const QJsonObject & json = this->_json;
+
+    // Get shape color (or default if not specified)
+    const VibesStyle & style = this->style();
+
+    Q_ASSERT(json.contains("type"));
+    Q_ASSERT(json["type"].toString() == "lines" || json["type"].toString() == "polygons");
+
+    const VibesMatrix coordinates = matrix("coordinates");
+    const VibesMatrix offsets = matrix("offsets");
+    const int dim = this->_nbDim;
+
+    // Project all the points in one strided pass
+    const int nbPoints = coordinates.cols() / dim;
+    const double *c = coordinates.row(0);
+    _points.resize(nbPoints);
+    QPointF *points = _points.data();
+    for (int i = 0; i < nbPoints; ++i)
+        points[i] = QPointF(c[i * dim + dimX], c[i * dim + dimY]);
+
+    const int count = offsets.cols() - 1;
+    _offsets.resize(count + 1);
+    for (int i = 0; i <= count; ++i)
+        _offsets[i] = int(offsets.at(0, i));
+
+    // Bounds of each polyline
+    _polylineBounds.resize(count);
+    QRectF bounds;
+    bool hasBounds = false;
+    for (int i = 0; i < count; ++i)
+    {
+        const int begin = _offsets.at(i), end = _offsets.at(i + 1);
+        if (begin == end)
+        {
+            _polylineBounds[i] = QRectF();
+            continue;
+        }
+        double xmin = points[begin].x(), xmax = xmin, ymin = points[begin].y(), ymax = ymin;
+        for (int j = begin + 1; j < end; ++j)
+        {
+            xmin = points[j].x() < xmin ? points[j].x() : xmin;
+            xmax = points[j].x() > xmax ? points[j].x() : xmax;
+            ymin = points[j].y() < ymin ? points[j].y() : ymin;
+            ymax = points[j].y() > ymax ? points[j].y() : ymax;
+        }
+        _polylineBounds[i] = QRectF(QPointF(xmin, ymin), QPointF(xmax, ymax));
+        // (single points and straight lines have null bounds, which united() ignores)
+        if (!hasBounds)
+            bounds = _polylineBounds[i];
+        else
+            bounds = QRectF(QPointF(qMin(bounds.left(), xmin), qMin(bounds.top(), ymin)),
+                            QPointF(qMax(bounds.right(), xmax), qMax(bounds.bottom(), ymax)));
+        hasBounds = true;
+    }
+
+    this->prepareGeometryChange();
+    // Margin for the pen width
+    const double margin = style.pen.widthF() / 2.;
+    _boundingRect = bounds.adjusted(-margin, -margin, margin, margin);
+
+    this->setPen(style.pen);
+    this->setBrush(_closed ? style.brush : Qt::NoBrush);
+    // Only repaint the exposed polylines
+    this->setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+
+    // Update successful
+    return true;
+}
+
+void VibesGraphicsPolylines::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+{
+    const QRectF exposed = option->exposedRect;
+    painter->setBrush(brush());
+    painter->setPen(paintPen(pen()));
+
+    // Visible polylines are drawn straight from the contiguous points. Bounds of horizontal or
+    // vertical polylines are flat: overlap is tested with the edges included.
+    const double margin = pen().widthF() / 2.;
+    const QRectF visible = exposed.adjusted(-margin, -margin, margin, margin);
+    const QPointF *points = _points.constData();
+    for (int i = 0; i < _polylineBounds.size(); ++i)
+    {
+        const int begin = _offsets.at(i), end = _offsets.at(i + 1);
+        const QRectF & bounds = _polylineBounds.at(i);
+        if (begin == end || bounds.right() < visible.left() || bounds.left() > visible.right()
+                || bounds.bottom() < visible.top() || bounds.top() > visible.bottom())
+            continue;
+        if (_closed)
+            painter->drawPolygon(points + begin, end - begin);
+        else
+            painter->drawPolyline(points + begin, end - begin);
+    }
+}
+
+//
+// VibesGraphicsEllipses
+//
+
+bool VibesGraphicsEllipses::parseJsonGraphics(const QJsonObject &json)
+{
+    // Now process shape-specific properties
+    // (we can only update properties of a shape, but mutation into another type is not supported)
+    if (json.contains("type"))
+    {
+        // Retrieve type
+        QString type = json["type"].toString();
+
+        // VibesGraphicsEllipses has JSON type "ellipses"
+        if (type == "ellipses")
+        {
+            // One center and one flattened covariance matrix per ellipse
+            const VibesMatrix centers = matrix("centers");
+            const VibesMatrix covariances = matrix("covariances");
+            if (centers.isEmpty() || centers.cols() < 2) return false;
+            if (covariances.rows() != centers.rows() || covariances.cols() != centers.cols() * centers.cols()) return false;
+            // Set dimension
+            this->_nbDim = centers.cols();
+
+            // Update successful
+            return true;
+        }
+    }
+
+    // Unknown or empty JSON, update failed
+    return false;
+}
+
+bool VibesGraphicsEllipses::computeProjection(int dimX, int dimY)
+{
+    const QJsonObject & json = this->_json;
+
+    // Get shape color (or default if not specified)
+    const VibesStyle & style = this->style();
+
+    Q_ASSERT(json.contains("type"));
+    Q_ASSERT(json["type"].toString() == "ellipses");
+
+    const VibesMatrix centers = matrix("centers");
+    const VibesMatrix covariances = matrix("covariances");
+    const int dim = centers.cols();
+    const double k = json.contains("sigma") ? json["sigma"].toDouble() : 5;
+
+    // Projected centers and covariance terms, as contiguous columns
+    const QVector<double> c = centers.gather(QVector<int>() << dimX << dimY);
+    const QVector<double> cov = covariances.gather(QVector<int>() << dimX * dim + dimX << dimX * dim + dimY << dimY * dim + dimY);
+    const int n = centers.rows();
+    const double *cx = c.constData(), *cy = cx + n;
+    const double *sxx = cov.constData(), *sxy = sxx + n, *syy = sxy + n;
+
+    _geometry.resize(Columns * n);
+    double *g = _geometry.data();
+    double *x = g + CenterX * n, *y = g + CenterY * n;
+    double *ax = g + MajorX * n, *ay = g + MajorY * n, *bx = g + MinorX * n, *by = g + MinorY * n;
+    double *hx = g + ExtentX * n, *hy = g + ExtentY * n;
+
+    // Closed-form eigen-decomposition of all the symmetric 2x2 covariances, without branches
+    // (one pass over contiguous columns, which the compiler can vectorize)
+    for (int i = 0; i < n; ++i)
+    {
+        const double half_diff = (sxx[i] - syy[i]) / 2.;
+        const double mean = (sxx[i] + syy[i]) / 2.;
+        const double d = std::sqrt(half_diff * half_diff + sxy[i] * sxy[i]);
+        const double eval1 = mean + d;
+        const double eval2 = mean - d > 0. ? mean - d : 0.;
+        // Angle of the major axis from the half-angle formulas (any angle for circles)
+        const double cos2 = d > 0. ? half_diff / d : 1.;
+        const double cos_a = std::sqrt((1. + cos2) / 2.);
+        const double sin_a = std::copysign(std::sqrt((1. - cos2) / 2.), sxy[i]);
+        const double wx = k * std::sqrt(eval1), wy = k * std::sqrt(eval2);
+        x[i] = cx[i];
+        y[i] = cy[i];
+        ax[i] = wx * cos_a;
+        ay[i] = wx * sin_a;
+        bx[i] = -wy * sin_a;
+        by[i] = wy * cos_a;
+        hx[i] = k * std::sqrt(sxx[i] > 0. ? sxx[i] : 0.);
+        hy[i] = k * std::sqrt(syy[i] > 0. ? syy[i] : 0.);
+    }
+
+    // Bounding rect, from separate min/max reductions
+    double xmin = x[0] - hx[0], xmax = x[0] + hx[0], ymin = y[0] - hy[0], ymax = y[0] + hy[0];
+    for (int i = 1; i < n; ++i)
+        xmin = x[i] - hx[i] < xmin ? x[i] - hx[i] : xmin;
+    for (int i = 1; i < n; ++i)
+        xmax = x[i] + hx[i] > xmax ? x[i] + hx[i] : xmax;
+    for (int i = 1; i < n; ++i)
+        ymin = y[i] - hy[i] < ymin ? y[i] - hy[i] : ymin;
+    for (int i = 1; i < n; ++i)
+        ymax = y[i] + hy[i] > ymax ? y[i] + hy[i] : ymax;
+
+    if (_unitCircles.isEmpty())
+    {
+        for (int segments = 8; segments <= 256; segments *= 2)
+        {
+            QPolygonF circle;
+            circle.reserve(segments);
+            for (int j = 0; j < segments; ++j)
+                circle << QPointF(std::cos(2. * M_PI * j / segments), std::sin(2. * M_PI * j / segments));
+            _unitCircles << circle;
         }
     }
 
+    this->prepareGeometryChange();
+    // Margin for the pen width
+    const double margin = style.pen.widthF() / 2.;
+    _boundingRect = QRectF(QPointF(xmin, ymin), QPointF(xmax, ymax)).adjusted(-margin, -margin, margin, margin);
+
+    this->setPen(style.pen);
+    this->setBrush(style.brush);
+    // Only repaint the exposed ellipses
+    this->setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+
     // Update successful
     return true;
 }
 
+void VibesGraphicsEllipses::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+{
+    const int n = count();
+    if (n == 0 || _unitCircles.isEmpty())
+        return;
+    const double lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    const double *x = column(CenterX), *y = column(CenterY);
+    const double *ax = column(MajorX), *ay = column(MajorY), *bx = column(MinorX), *by = column(MinorY);
+    const double *hx = column(ExtentX), *hy = column(ExtentY);
+
+    const QRectF exposed = option->exposedRect;
+    painter->setBrush(brush());
+    painter->setPen(paintPen(pen()));
+
+    QPolygonF polygon;
+    for (int i = 0; i < n; ++i)
+    {
+        const QRectF bounds(x[i] - hx[i], y[i] - hy[i], 2. * hx[i], 2. * hy[i]);
+        if (!bounds.intersects(exposed) && !exposed.contains(bounds.topLeft()))
+            continue;
+
+        // Unit circle with enough segments for the on-screen size, mapped on the ellipse axes
+        const double pixels = qMax(hx[i], hy[i]) * lod;
+        int level = 0;
+        while (level + 1 < _unitCircles.size() && (8 << level) < pixels)
+            ++level;
+        const QPolygonF & circle = _unitCircles.at(level);
+        polygon.resize(circle.size());
+        for (int j = 0; j < circle.size(); ++j)
+        {
+            const QPointF & p = circle.at(j);
+            polygon[j] = QPointF(x[i] + p.x() * ax[i] + p.y() * bx[i], y[i] + p.x() * ay[i] + p.y() * by[i]);
+        }
+        painter->drawPolygon(polygon);
+    }
+}
 
 //
-// VibesGraphicsPie
+// VibesGraphicsPies
 //
 
-bool VibesGraphicsPie::parseJsonGraphics(const QJsonObject &json)
+bool VibesGraphicsPies::parseJsonGraphics(const QJsonObject &json)
 {
     // Now process shape-specific properties
     // (we can only update properties of a shape, but mutation into another type is not supported)
@@ -1797,21 +2811,24 @@ bool VibesGraphicsPie::parseJsonGraphics(const QJsonObject &json)
         // Retrieve type
         QString type = json["type"].toString();
 
-        // VibesGraphicsPie has JSON type "pie"
-        if (type == "pie" && json.contains("center"))
+        // VibesGraphicsPies has JSON type "pies"
+        if (type == "pies")
         {
-            QJsonArray center = json["center"].toArray();
-            if (center.size() != 2) return false;
-            if (json.contains("rho"))
-            {
-                if (json["rho"].toArray().size() != 2) return false;
-            }
-            else if (json.contains("theta"))
+            // One (x,y) center and one (min,max) radius range per pie. Without angular
+            // range, pies are full rings.
+            const VibesMatrix centers = matrix("centers");
+            const VibesMatrix rho = matrix("rho");
+            const VibesMatrix theta = matrix("theta");
+            if (centers.isEmpty() || centers.cols() != 2) return false;
+            if (rho.rows() != centers.rows() || rho.cols() != 2) return false;
+            if (!theta.isEmpty() && (theta.rows() != centers.rows() || theta.cols() != 2)) return false;
+            // Radius ranges are ordered and non-negative, as for a single pie
+            for (int i = 0; i < rho.rows(); ++i)
             {
-                if (json["theta"].toArray().size() != 2) return false;
+                if (!(rho.at(i, 0) >= 0 && rho.at(i, 0) <= rho.at(i, 1))) return false;
             }
             // Compute dimension
-            this->_nbDim = center.size();
+            this->_nbDim = centers.cols();
 
             // Update successful
             return true;
@@ -1822,81 +2839,155 @@ bool VibesGraphicsPie::parseJsonGraphics(const QJsonObject &json)
     return false;
 }
 
-bool VibesGraphicsPie::computeProjection(int dimX, int dimY)
+bool VibesGraphicsPies::computeProjection(int /*dimX*/, int /*dimY*/)
 {
     const QJsonObject & json = this->_json;
 
     // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const VibesStyle & style = this->style();
 
     // Now process shape-specific properties
     // (we can only update properties of a shape, but mutation into another type is not supported)
     Q_ASSERT(json.contains("type"));
-    // VibesGraphicsPie has JSON type "pie"
-    Q_ASSERT(json["type"].toString() == "pie");
-
-    QJsonArray center = json["center"].toArray();
-    QJsonArray rho = json["rho"].toArray();
-    QJsonArray theta = json["theta"].toArray();
-
-    Q_ASSERT(rho[0].toDouble() >= 0);
-    Q_ASSERT(rho[1].toDouble() >= rho[0].toDouble());
-
-    // If the shape has already been drawn, it has at least one child
-    // Update child items if they exist
-    if (this->childItems().size() > 0)
-    {
-        foreach(QGraphicsItem * item, this->childItems())
+    // VibesGraphicsPies has JSON type "pies"
+    Q_ASSERT(json["type"].toString() == "pies");
+
+    const VibesMatrix centers = matrix("centers");
+    const VibesMatrix rho = matrix("rho");
+    const VibesMatrix theta = matrix("theta");
+    const bool rings = theta.isEmpty();
+    const int count = centers.rows();
+
+    // Bounds of each pie: ends of its arcs, and the extreme points of the outer circle it contains
+    _pieBounds.resize(count);
+    QRectF bounds;
+    for (int i = 0; i < count; ++i)
+    {
+        const double cx = centers.at(i, 0), cy = centers.at(i, 1);
+        const double rho_m = rho.at(i, 0), rho_p = rho.at(i, 1);
+        QRectF pieBounds(QPointF(cx - rho_p, cy - rho_p), QPointF(cx + rho_p, cy + rho_p));
+        if (!rings && std::fabs(theta.at(i, 1) - theta.at(i, 0)) < 360.)
         {
-            //to vibes graphics item
-            QGraphicsPathItem *graphics_polygon = qgraphicsitem_cast<QGraphicsPathItem *>(item);
-            graphics_polygon->setPen(pen);
-            graphics_polygon->setBrush(brush);
+            // Angles are in degrees and counterclockwise (bounds may be given in any order)
+            const double theta_m = qMin(theta.at(i, 0), theta.at(i, 1)), theta_p = qMax(theta.at(i, 0), theta.at(i, 1));
+            const double c_m = std::cos(theta_m * M_PI / 180.0), s_m = std::sin(theta_m * M_PI / 180.0);
+            const double c_p = std::cos(theta_p * M_PI / 180.0), s_p = std::sin(theta_p * M_PI / 180.0);
+            double xmin = qMin(qMin(rho_m * c_m, rho_p * c_m), qMin(rho_m * c_p, rho_p * c_p));
+            double xmax = qMax(qMax(rho_m * c_m, rho_p * c_m), qMax(rho_m * c_p, rho_p * c_p));
+            double ymin = qMin(qMin(rho_m * s_m, rho_p * s_m), qMin(rho_m * s_p, rho_p * s_p));
+            double ymax = qMax(qMax(rho_m * s_m, rho_p * s_m), qMax(rho_m * s_p, rho_p * s_p));
+            // Axis directions swept by the arc
+            for (int k = int(std::ceil(theta_m / 90.)); k * 90. <= theta_p; ++k)
+            {
+                switch (((k % 4) + 4) % 4)
+                {
+                case 0: xmax = rho_p; break;
+                case 1: ymax = rho_p; break;
+                case 2: xmin = -rho_p; break;
+                case 3: ymin = -rho_p; break;
+                }
+            }
+            pieBounds = QRectF(QPointF(cx + xmin, cy + ymin), QPointF(cx + xmax, cy + ymax));
         }
+        _pieBounds[i] = pieBounds;
+        bounds = (i == 0) ? pieBounds : bounds.united(pieBounds);
     }
-    // Else draw the shape for the first time
-    else{
-        // Body
-        {
 
-            double cx = center[0].toDouble();
-            double cy = center[1].toDouble();
+    // Outlines are tessellated when first painted
+    _outlines.fill(QPolygonF(), count);
+    _holes.fill(QPolygonF(), count);
+    _levels.fill(INT_MIN, count);
 
-            double rho_m = rho[0].toDouble();
-            double rho_p = rho[1].toDouble();
-            double theta_m = -theta[0].toDouble();
-            double theta_p = -theta[1].toDouble();
+    this->prepareGeometryChange();
+    // Margin for the pen width
+    const double margin = style.pen.widthF() / 2.;
+    _boundingRect = bounds.adjusted(-margin, -margin, margin, margin);
 
-            // Angles are in degree and in clock-wise
-            double m1_x = cx + rho_m * std::cos(-theta_m * M_PI / 180.0);
-            double m1_y = cy + rho_m * std::sin(-theta_m * M_PI / 180.0);
+    this->setPen(style.pen);
+    this->setBrush(style.brush);
+    // Only repaint the exposed pies
+    this->setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
 
-            double m2_x = cx + rho_m * std::cos(-theta_p * M_PI / 180.0);
-            double m2_y = cy + rho_m * std::sin(-theta_p * M_PI / 180.0);
+    // Update successful
+    return count > 0;
+}
 
-            double m4_x = cx + rho_p * std::cos(-theta_m * M_PI / 180.0);
-            double m4_y = cy + rho_p * std::sin(-theta_m * M_PI / 180.0);
+void VibesGraphicsPies::tessellate(int i, int level)
+{
+    const VibesMatrix centers = matrix("centers");
+    const VibesMatrix rho = matrix("rho");
+    const VibesMatrix theta = matrix("theta");
+    const double cx = centers.at(i, 0), cy = centers.at(i, 1);
+    const double rho_m = rho.at(i, 0), rho_p = rho.at(i, 1);
+    const bool ring = theta.isEmpty() || std::fabs(theta.at(i, 1) - theta.at(i, 0)) >= 360.;
+    const double theta_m = ring ? 0. : qMin(theta.at(i, 0), theta.at(i, 1)) * M_PI / 180.0;
+    const double span = ring ? 2. * M_PI : std::fabs(theta.at(i, 1) - theta.at(i, 0)) * M_PI / 180.0;
+
+    // Step keeping chords within a quarter pixel of the outer arc, at the finest zoom of this level
+    const double pixels = rho_p * std::ldexp(1., level);
+    const double step = (pixels > 8.) ? std::sqrt(2. / pixels) : M_PI / 8.;
+    const int segments = qBound(1, int(std::ceil(span / step)), 4096);
+
+    QPolygonF outer, inner;
+    outer.reserve(segments + 1);
+    for (int k = 0; k <= segments; ++k)
+    {
+        const double angle = theta_m + span * k / segments;
+        outer << QPointF(cx + rho_p * std::cos(angle), cy + rho_p * std::sin(angle));
+    }
+    if (rho_m > 0.)
+    {
+        inner.reserve(segments + 1);
+        for (int k = segments; k >= 0; --k)
+        {
+            const double angle = theta_m + span * k / segments;
+            inner << QPointF(cx + rho_m * std::cos(angle), cy + rho_m * std::sin(angle));
+        }
+    }
 
-            double dtheta = theta_p - theta_m;
+    if (ring)
+    {
+        _outlines[i] = outer;
+        _holes[i] = inner;
+    }
+    else
+    {
+        // Outer arc, then inner arc backwards (or the center)
+        _outlines[i] = outer + (inner.isEmpty() ? QPolygonF() << QPointF(cx, cy) : inner);
+        _holes[i] = QPolygonF();
+    }
+    _levels[i] = level;
+}
 
-            QPainterPath path(QPointF(m1_x, m1_y));
-            path.lineTo(m4_x, m4_y);
-            path.arcTo(QRectF(QPointF(cx - rho_p, cy - rho_p), QPointF(cx + rho_p, cy + rho_p)), theta_m, dtheta);
-            path.lineTo(m2_x, m2_y);
-            path.arcTo(QRectF(QPointF(cx - rho_m, cy - rho_m), QPointF(cx + rho_m, cy + rho_m)), theta_p, -dtheta);
+void VibesGraphicsPies::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+{
+    // Zoom levels are powers of two: pies are tessellated for the finest zoom of the current level
+    const double lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+    const int level = (lod > 0.) ? int(std::ceil(std::log2(lod))) : 0;
 
-            // Draw with the new properties
-            QGraphicsPathItem *graphics_path = new QGraphicsPathItem(path);
-            graphics_path->setPen(pen);
-            graphics_path->setBrush(brush);
-            this->addToGroup(graphics_path);
+    const QRectF exposed = option->exposedRect;
+    painter->setBrush(brush());
+    painter->setPen(paintPen(pen()));
 
+    for (int i = 0; i < _pieBounds.size(); ++i)
+    {
+        const QRectF & pieBounds = _pieBounds.at(i);
+        if (!pieBounds.intersects(exposed) && !exposed.contains(pieBounds.topLeft()))
+            continue;
+        if (_levels.at(i) != level)
+            tessellate(i, level);
+        if (_holes.at(i).isEmpty())
+        {
+            painter->drawPolygon(_outlines.at(i));
+        }
+        else
+        {
+            QPainterPath path;
+            path.addPolygon(_outlines.at(i));
+            path.addPolygon(_holes.at(i));
+            painter->drawPath(path);
         }
     }
-
-    // Update successful
-    return true;
 }
 
 bool VibesGraphicsPoint::parseJsonGraphics(const QJsonObject& json)
@@ -1959,8 +3050,9 @@ bool VibesGraphicsPoint::computeProjection(int dimX, int dimY)
         double cx = point[0].toDouble();
         double cy = point[1].toDouble();
 
-        const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-        const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+        const VibesStyle & style = this->style();
+        const QBrush & brush = style.brush;
+        const QPen & pen = style.pen;
 
         // Now process shape-specific properties
         // (we can only update properties of a shape, but mutation into another type is not supported)
@@ -1983,10 +3075,29 @@ bool VibesGraphicsPoint::computeProjection(int dimX, int dimY)
     return true;
 }
 
+void VibesGraphicsPoint::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    // Draft mode: a square is much cheaper to rasterize than an ellipse
+    if (VibesGraphicsItem::scene() && VibesGraphicsItem::scene()->isDraft())
+    {
+        painter->setPen(pen());
+        painter->setBrush(brush());
+        painter->drawRect(rect());
+        return;
+    }
+    QGraphicsEllipseItem::paint(painter, option, widget);
+}
+
 //
 // VibesGraphicsPoints
 //
 
+void VibesGraphicsPoints::updateElementColors()
+{
+    _colors = elementColors(_radiuses.size());
+    this->update();
+}
+
 bool VibesGraphicsPoints::parseJsonGraphics(const QJsonObject& json)
 {
     // Now process shape-specific properties
@@ -1999,8 +3110,10 @@ bool VibesGraphicsPoints::parseJsonGraphics(const QJsonObject& json)
         // VibesGraphicsPoints has JSON type "points"
         if (type == "points")
         {
-            QJsonArray centers = json["centers"].toArray();
-            this->_nbDim=centers[0].toArray().size();
+            const VibesMatrix centers = matrix("centers");
+            if (centers.isEmpty() || centers.isVector() || centers.cols() < 2)
+                return false;
+            this->_nbDim = centers.cols();
 
             if (json.contains("Draggable"))
             {
@@ -2013,15 +3126,7 @@ bool VibesGraphicsPoints::parseJsonGraphics(const QJsonObject& json)
                     this->setFlag(QGraphicsItem::ItemIsMovable, ((int) json["Draggable"].toDouble(0)) == 1);
                 }
             }
-            QList<QGraphicsItem*> pts = this->childItems();
 
-            foreach(QGraphicsItem* item, pts)
-            {
-                QGraphicsEllipseItem * disk = qgraphicsitem_cast<QGraphicsEllipseItem*>(item);
-                if (!disk) continue;
-                disk->setPen(vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString()));
-                disk->setBrush(vibesDefaults.brush(jsonValue("FaceColor").toString()));
-            }
             // Update successful
             return true;
         }
@@ -2031,13 +3136,21 @@ bool VibesGraphicsPoints::parseJsonGraphics(const QJsonObject& json)
     return false;
 }
 
+bool VibesGraphicsPoints::projectionColumns(int dimX, int dimY, QString &key, QVector<int> &columns) const
+{
+    key = "centers";
+    columns = QVector<int>() << dimX << dimY;
+    return true;
+}
+
 bool VibesGraphicsPoints::computeProjection(int dimX, int dimY)
 {
     const QJsonObject & json = this->_json;
 
     // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const VibesStyle & style = this->style();
+    const QBrush & brush = style.brush;
+    const QPen & pen = style.pen;
 
     // Now process shape-specific properties
     // (we can only update properties of a shape, but mutation into another type is not supported)
@@ -2045,58 +3158,114 @@ bool VibesGraphicsPoints::computeProjection(int dimX, int dimY)
     // VibesGraphicscPoints has JSON type "points"
     Q_ASSERT(json["type"].toString() == "points");
 
-    // Before update, we first remove all existing points
-    {
-        QList<QGraphicsItem*> disks = this->childItems();
-        foreach(QGraphicsItem* disk, disks) delete disk;
-    }
+    const VibesProjection & centers = projection(dimX, dimY);
+    if (centers.rows == 0)
+        return false;
+    const double *xs = centers.column(0), *ys = centers.column(1);
+    const int s = centers.stride;
 
-    QJsonArray levels, radiuses;
-    double radius = 0.01;
-    bool levelsExist = false;//json.contains("ColorLevels");
-    if (levelsExist)levels = json["ColorLevels"].toArray();
-    bool radiusesExist = json.contains("Radiuses");
-    if (radiusesExist)radiuses = json["Radiuses"].toArray();
-    if (!radiusesExist)
-    {
-        if (json.contains("Radius"))
+    // Radius of each point: its own, or the common one
+    const VibesMatrix radiuses = matrix("Radiuses");
+    if (!radiuses.isEmpty() && radiuses.data().size() >= centers.rows)
+        _radiuses = radiuses.data().mid(0, centers.rows);
+    else
+        _radiuses.fill(json["Radius"].toDouble(0.01), centers.rows);
+    // Default behaviour for points is a fixed size on screen
+    _fixedScale = json["FixedScale"].toBool(true);
+    _colors = elementColors(centers.rows);
+
+    // Bounds of the centers, from separate min/max reductions
+    double xmin = xs[0], xmax = xs[0], ymin = ys[0], ymax = ys[0];
+    for (int i = 1; i < centers.rows; ++i)
+        xmin = xs[i * s] < xmin ? xs[i * s] : xmin;
+    for (int i = 1; i < centers.rows; ++i)
+        xmax = xs[i * s] > xmax ? xs[i * s] : xmax;
+    for (int i = 1; i < centers.rows; ++i)
+        ymin = ys[i * s] < ymin ? ys[i * s] : ymin;
+    for (int i = 1; i < centers.rows; ++i)
+        ymax = ys[i * s] > ymax ? ys[i * s] : ymax;
+    double maxRadius = 0.;
+    for (int i = 0; i < _radiuses.size(); ++i)
+        maxRadius = _radiuses[i] > maxRadius ? _radiuses[i] : maxRadius;
+
+    // Margin for the disks and the pen width. Fixed scale points are sized in pixels:
+    // their margin is converted to the scene with the most zoomed out view showing them,
+    // and computed again when a view is zoomed (see VibesScene2D::viewZoomChanged()).
+    double margin = maxRadius + pen.widthF() / 2.;
+    if (_fixedScale)
+    {
+        double lod = 0.;
+        if (VibesGraphicsItem::scene())
         {
-            radius = json["Radius"].toDouble(0.01);
+            foreach (QGraphicsView *view, VibesGraphicsItem::scene()->views())
+            {
+                const double viewLod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(view->transform());
+                lod = (lod == 0. || viewLod < lod) ? viewLod : lod;
+            }
         }
+        margin = (maxRadius + qMax(1., pen.widthF())) / (lod > 0. ? lod : 1.);
     }
-    QJsonArray centers = json["centers"].toArray();
-
-    for (unsigned int i = 0; i < centers.size(); i++)
-    {
-        const QJsonArray point = centers[i].toArray();
-        double x = point[dimX].toDouble();
-        double y = point[dimY].toDouble();
+    if (VibesGraphicsItem::scene())
+        VibesGraphicsItem::scene()->setZoomDependent(this, _fixedScale);
 
-        double r = radiusesExist ? radiuses[i].toDouble() : radius;
+    this->prepareGeometryChange();
+    _boundingRect = QRectF(QPointF(xmin, ymin), QPointF(xmax, ymax)).adjusted(-margin, -margin, margin, margin);
 
-        // Draw with the new properties
-        QGraphicsEllipseItem * disk = new QGraphicsEllipseItem(-r, -r, 2 * r, 2 * r);
-        disk->setPos(x, y);
+    this->setPen(pen);
+    this->setBrush(brush);
+    // Only repaint the exposed points
+    this->setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
 
-        disk->setPen(pen);
-        disk->setBrush(brush);
+    // Update successful
+    return true;
+}
 
-        disk->setFlag(QGraphicsItem::ItemIgnoresTransformations, true);
-        if (json.contains("FixedScale"))
+void VibesGraphicsPoints::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+{
+    if (!existsInProj(dimX(), dimY()))
+        return;
+    const VibesProjection & centers = projection(dimX(), dimY());
+    if (centers.rows == 0 || centers.rows != _radiuses.size())
+        return;
+    const double *xs = centers.column(0), *ys = centers.column(1);
+    const int s = centers.stride;
+    const double *radiuses = _radiuses.constData();
+    const bool colored = (_colors.size() == centers.rows);
+
+    const QPen pen = paintPen(this->pen());
+
+    // Fixed scale points are drawn in device coordinates, with their radius in pixels
+    const QTransform world = painter->worldTransform();
+    const double lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(world);
+    const double scale = (_fixedScale && lod > 0.) ? 1. / lod : 1.;
+    const double penMargin = qMax(1., pen.widthF());
+    const QRectF exposed = option->exposedRect;
+    painter->save();
+    if (_fixedScale)
+        painter->resetTransform();
+    painter->setPen(pen);
+    painter->setBrush(brush());
+
+    // One pass over the visible points, changing the brush only between points of different colors
+    QRgb brushColor = 0;
+    bool brushSet = false;
+    for (int i = 0; i < centers.rows; ++i)
+    {
+        const double margin = (radiuses[i] + penMargin) * scale;
+        const double x = xs[i * s], y = ys[i * s];
+        if (x + margin < exposed.left() || x - margin > exposed.right()
+                || y + margin < exposed.top() || y - margin > exposed.bottom())
+            continue;
+        if (colored && (!brushSet || _colors.at(i) != brushColor))
         {
-            // Default behaviour for points is true
-            disk->setFlag(QGraphicsItem::ItemIgnoresTransformations, json["FixedScale"].toBool(true));
+            brushColor = _colors.at(i);
+            brushSet = true;
+            painter->setBrush(QColor::fromRgba(brushColor));
         }
-        this->addToGroup(disk);
-
-        //if(levelsExist)
-        //{
-        // TODO: apply colormap
-        //}
+        const QPointF center = _fixedScale ? world.map(QPointF(x, y)) : QPointF(x, y);
+        painter->drawEllipse(center, radiuses[i], radiuses[i]);
     }
-
-    // Update successful
-    return true;
+    painter->restore();
 }
 
 //
@@ -2135,8 +3304,9 @@ bool VibesGraphicsRing::computeProjection(int dimX, int dimY)
     const QJsonObject & json = this->_json;
 
     // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+    const VibesStyle & style = this->style();
+    const QBrush & brush = style.brush;
+    const QPen & pen = style.pen;
 
     // Now process shape-specific properties
     // (we can only update properties of a shape, but mutation into another type is not supported)
@@ -2247,7 +3417,7 @@ bool VibesGraphicsRaster::computeProjection(int dimX, int dimY)
         double yres = size[1].toDouble()/pixmap.height();
         
         if (json.contains("EdgeColor")) {
-          const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(),jsonValue("LineWidth").toString());
+          const QPen pen = style().pen;
           pixmap.setMask(pixmap.createMaskFromColor(pen.color().rgb()));
 
         }
@@ -2268,10 +3438,10 @@ bool VibesGraphicsRaster::computeProjection(int dimX, int dimY)
 }
 
 //
-// VibesGraphicsCake
+// VibesGraphicsHeatmap
 //
 
-bool VibesGraphicsCake::parseJsonGraphics(const QJsonObject &json)
+bool VibesGraphicsHeatmap::parseJsonGraphics(const QJsonObject &json)
 {
     // Now process shape-specific properties
     // (we can only update properties of a shape, but mutation into another type is not supported)
@@ -2280,21 +3450,17 @@ bool VibesGraphicsCake::parseJsonGraphics(const QJsonObject &json)
         // Retrieve type
         QString type = json["type"].toString();
 
-        // JSON type for VibesGraphicsCake is "cake"
-        if (type == "cake")
+        // VibesGraphicsHeatmap has JSON type "heatmap"
+        if (type == "heatmap")
         {
-            if (json.contains("center") && json.contains("length") && json.contains("orientation"))
-            {
-                int center_size = json["center"].toArray().size();
-                if (center_size == 2 && json["length"].toDouble() > 0.)
-                {
-                    // Set dimension
-                    this->_nbDim = center_size;
+            // A matrix of values, and the bounds (xlb, xub, ylb, yub) it covers
+            if (matrix("data").isEmpty()) return false;
+            if (json["bounds"].toArray().size() != 4) return false;
+            // Heatmaps are 2D only
+            this->_nbDim = 2;
 
-                    // Update successful
-                    return true;
-                }
-            }
+            // Update successful
+            return true;
         }
     }
 
@@ -2302,183 +3468,115 @@ bool VibesGraphicsCake::parseJsonGraphics(const QJsonObject &json)
     return false;
 }
 
-bool VibesGraphicsCake::computeProjection(int dimX, int dimY)
+bool VibesGraphicsHeatmap::computeProjection(int dimX, int dimY)
 {
     const QJsonObject & json = this->_json;
 
-    QJsonArray center = json["center"].toArray();
-    double length = json["length"].toDouble();
-    double orientation = json["orientation"].toDouble();
-
-    // Get shape color (or default if not specified)
-    const QBrush & brush = vibesDefaults.brush(jsonValue("FaceColor").toString());
-    const QPen & pen = vibesDefaults.pen(jsonValue("EdgeColor").toString(),jsonValue("LineStyle").toString(), QString::number(7.0*jsonValue("LineWidth").toString().toDouble()/length));
-
-    const QBrush & cake_brush = vibesDefaults.brush("#ffde85");
-    const QPen & cake_pen = vibesDefaults.pen("black","-", "0.1");
-    const QPen & text_pen = vibesDefaults.pen("#525252","-", "0.5");
-
-    const QBrush & cream_brush = vibesDefaults.brush("#fcf7e8");
-
-    const QPen & empty_pen = vibesDefaults.pen("transparent","-", jsonValue("LineWidth").toString());
-
-
     Q_ASSERT(json.contains("type"));
-    Q_ASSERT(json["type"].toString() == "cake");
-
-    Q_ASSERT(center.size() == 2);
-    Q_ASSERT(this->_nbDim == center.size());
-    Q_ASSERT(length > 0.);
-
-    // Get center
-    const QPointF & centerPoint = QPointF(center[dimX].toDouble(), center[dimY].toDouble());
+    // VibesGraphicsHeatmap has JSON type "heatmap"
+    Q_ASSERT(json["type"].toString() == "heatmap");
 
-    /*  This shape is inspired by the MOOS middleware GUI (see pMarineViewer)   */
+    // Heatmaps are not transposed
+    if (dimX != 0 || dimY != 1)
+        return false;
 
-    // If the shape has already been drawn, it has at least one child
-    // Update child items if they exist
-    if (this->childItems().size() > 0)
+    const QJsonArray bounds = json["bounds"].toArray();
+    const QRectF rect = QRectF(QPointF(bounds[0].toDouble(), bounds[2].toDouble()),
+                               QPointF(bounds[1].toDouble(), bounds[3].toDouble())).normalized();
+    if (rect != _rect)
     {
-        // This cake is already perfect, please don't change it
+        this->prepareGeometryChange();
+        _rect = rect;
     }
-    // Else draw the shape for the first time
-    else{
-        // Set body shape
-        {
-            QGraphicsEllipseItem * disk = new QGraphicsEllipseItem(center[dimX].toDouble()-length/2.0, center[dimY].toDouble()-length/8.0, length, length/4.);
+    updateImage();
+    // Only repaint the exposed part of the image
+    this->setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
 
-            disk->setPen(cake_pen);
-            disk->setBrush(cake_brush);
-            disk->setTransformOriginPoint(centerPoint);
-            disk->setRotation(orientation);
-            this->addToGroup(disk);
-        }
-
-        {
-            QGraphicsRectItem * rect = new QGraphicsRectItem(center[dimX].toDouble()-length/2.0, center[dimY].toDouble(), length, length/2.);
-            rect->setPen(empty_pen);
-            rect->setBrush(cake_brush);
-            rect->setTransformOriginPoint(centerPoint);
-            rect->setRotation(orientation);
-            this->addToGroup(rect);
-
-        }
-
-        {
-            QGraphicsEllipseItem * disk = new QGraphicsEllipseItem(center[dimX].toDouble()-length/2.0, center[dimY].toDouble()+length/4., length, length/4.);
-
-            disk->setPen(empty_pen);
-            disk->setBrush(cream_brush);
-            disk->setTransformOriginPoint(centerPoint);
-            disk->setRotation(orientation);
-            this->addToGroup(disk);
-        }
-
-        {
-            QGraphicsRectItem * rect = new QGraphicsRectItem(center[dimX].toDouble()-length/2.0, center[dimY].toDouble()+length/4. + length/8., length, length/8.);
-            rect->setPen(empty_pen);
-            rect->setBrush(cream_brush);
-            rect->setTransformOriginPoint(centerPoint);
-            rect->setRotation(orientation);
-            this->addToGroup(rect);
-        }
-
-        {
-            QPainterPath lef_line_details;
-            lef_line_details.moveTo(center[dimX].toDouble()-length/2.0, center[dimY].toDouble());
-            lef_line_details.lineTo(center[dimX].toDouble()-length/2.0, center[dimY].toDouble()+length/2.);
-            
-            QGraphicsPathItem * left_line = new QGraphicsPathItem(lef_line_details);
-
-            QPainterPath right_line_details;
-            right_line_details.moveTo(center[dimX].toDouble()+length/2.0, center[dimY].toDouble());
-            right_line_details.lineTo(center[dimX].toDouble()+length/2.0, center[dimY].toDouble()+length/2.);
-
-            QGraphicsPathItem * right_line = new QGraphicsPathItem(right_line_details);
+    // Update successful
+    return true;
+}
 
-            left_line->setPen(cake_pen);
-            right_line->setPen(cake_pen);
+void VibesGraphicsHeatmap::updateStyle()
+{
+    // A new color map or color range only changes the pixels
+    updateImage();
+}
 
-            left_line->setTransformOriginPoint(centerPoint);
-            right_line->setTransformOriginPoint(centerPoint);
+void VibesGraphicsHeatmap::updateImage()
+{
+    const VibesMatrix data = matrix("data");
+    if (_image.width() != data.cols() || _image.height() != data.rows())
+        _image = QImage(data.cols(), data.rows(), QImage::Format_ARGB32);
+    if (_image.isNull())
+        return;
+
+    VibesColorMap colorMap;
+    VibesColorMap::fromJson(jsonValue("ColorMap"), colorMap);
+    // Rows of 32-bit pixels are contiguous, like the rows of the matrix: all the values are
+    // mapped in a single pass, straight into the pixels
+    Q_ASSERT(_image.bytesPerLine() == _image.width() * int(sizeof(QRgb)));
+    colorMap.map(data.data().constData(), data.data().size(), jsonValue("ColorRange"),
+                 reinterpret_cast<QRgb*>(_image.bits()));
+    this->update();
+}
 
-            left_line->setRotation(orientation);
-            right_line->setRotation(orientation);
+QTransform VibesGraphicsHeatmap::imageTransform() const
+{
+    // Pixels are scaled to the bounds, row 0 being at the top (max ordinate)
+    return QTransform(_rect.width() / _image.width(), 0, 0, -_rect.height() / _image.height(),
+                      _rect.left(), _rect.bottom());
+}
 
-            this->addToGroup(left_line);
-            this->addToGroup(right_line);
-        }
+void VibesGraphicsHeatmap::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+{
+    if (_image.isNull() || _rect.isEmpty())
+        return;
+
+    // Only the pixels in the exposed area are drawn
+    const QTransform transform = imageTransform();
+    const QRect source = transform.inverted().mapRect(option->exposedRect).toAlignedRect() & _image.rect();
+    if (source.isEmpty())
+        return;
+
+    painter->save();
+    // Cells keep sharp edges
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter->setTransform(transform, true);
+    painter->drawImage(source.topLeft(), _image, source);
+    painter->restore();
+}
 
-        {
-            QGraphicsEllipseItem * disk = new QGraphicsEllipseItem(center[dimX].toDouble()-length/2.0, center[dimY].toDouble()+length/2.-length/8.0, length, length/4.);
+//
+// VibesGraphicsCake
+//
 
-            disk->setPen(cake_pen);
-            disk->setBrush(cream_brush);
-            disk->setTransformOriginPoint(centerPoint);
-            disk->setRotation(orientation);
-            this->addToGroup(disk);
-        }
+bool VibesGraphicsCake::parseJsonGraphics(const QJsonObject &json)
+{
+    // Now process shape-specific properties
+    // (we can only update properties of a shape, but mutation into another type is not supported)
+    if (json.contains("type"))
+    {
+        // Retrieve type
+        QString type = json["type"].toString();
 
+        // JSON type for VibesGraphicsCake is "cake"
+        if (type == "cake")
         {
-            QGraphicsEllipseItem * disk_1 = new QGraphicsEllipseItem(center[dimX].toDouble()-length/2.0, center[dimY].toDouble()+length/2.-length/16., length/8., length/8.);
-            QGraphicsEllipseItem * disk_2 = new QGraphicsEllipseItem(center[dimX].toDouble()+length/2.0-length/8., center[dimY].toDouble()+length/2.-length/16., length/8., length/8.);
-            QGraphicsEllipseItem * disk_3 = new QGraphicsEllipseItem(center[dimX].toDouble()-length/2.0+length/4., center[dimY].toDouble()+length/2.+length/16., length/8., length/8.);
-            QGraphicsEllipseItem * disk_4 = new QGraphicsEllipseItem(center[dimX].toDouble()+length/8., center[dimY].toDouble()+length/2.+length/16., length/8., length/8.);
-            QGraphicsEllipseItem * disk_5 = new QGraphicsEllipseItem(center[dimX].toDouble()-length/2.0+length/4., center[dimY].toDouble()+length/2.-length/8., length/8., length/8.);
-            QGraphicsEllipseItem * disk_6 = new QGraphicsEllipseItem(center[dimX].toDouble()+length/8., center[dimY].toDouble()+length/2.-length/8., length/8., length/8.);
-
-            QGraphicsSimpleTextItem * text = new QGraphicsSimpleTextItem("10");
-            text->setTransform(QTransform(1, 0, 0, -1, center[dimX].toDouble()-length/4.0-length/8.0,center[dimY].toDouble()+length));
-            text->setScale(0.04*length);
-            text->setPen(text_pen);
-            text->setBrush(brush);
-
-            disk_1->setPen(pen);
-            disk_2->setPen(pen);
-            disk_3->setPen(pen);
-            disk_4->setPen(pen);
-            disk_5->setPen(pen);
-            disk_6->setPen(pen);
-
-            disk_1->setBrush(brush);
-            disk_2->setBrush(brush);
-            disk_3->setBrush(brush);
-            disk_4->setBrush(brush);
-            disk_5->setBrush(brush);
-            disk_6->setBrush(brush);
-
-            disk_1->setTransformOriginPoint(centerPoint);
-            disk_2->setTransformOriginPoint(centerPoint);
-            disk_3->setTransformOriginPoint(centerPoint);
-            disk_4->setTransformOriginPoint(centerPoint);
-            disk_5->setTransformOriginPoint(centerPoint);
-            disk_6->setTransformOriginPoint(centerPoint);
-
-            disk_1->setRotation(orientation);
-            disk_2->setRotation(orientation);
-            disk_3->setRotation(orientation);
-            disk_4->setRotation(orientation);
-            disk_5->setRotation(orientation);
-            disk_6->setRotation(orientation);
-
-            this->addToGroup(disk_1);
-            this->addToGroup(disk_2);
-            this->addToGroup(disk_3);
-            this->addToGroup(disk_4);
-
-            if (orientation == 0)
-                this->addToGroup(text);
-
-            this->addToGroup(disk_5);
-            this->addToGroup(disk_6);
+            if (json.contains("center") && json.contains("length") && json.contains("orientation"))
+            {
+                int center_size = json["center"].toArray().size();
+                if (center_size == 2 && json["length"].toDouble() > 0.)
+                {
+                    // Set dimension
+                    this->_nbDim = center_size;
 
+                    // Update successful
+                    return true;
+                }
+            }
         }
-
-
     }
 
-
-
-    // Update successful
-    return true;
-}
\ No newline at end of file
+    // Unknown or empty JSON, update failed
+    return false;
+}
@@ -4,6 +4,8 @@
 #include <QGraphicsItem>
 #include <QJsonObject>
 #include <QJsonValue>
+#include <QVector>
+#include <QPair>
 
 //#include <QBitArray>
 #include "vibesscene2d.h"
@@ -11,9 +13,43 @@
 // VibesDefaults includes
 #include <QHash>
 #include <QPen>
+#include <QColor>
+#include <QPainterPath>
+#include <QTransform>
+#include <QImage>
 
 #include <QGraphicsSimpleTextItem>
 
+#if QT_VERSION >= 0x060000
+typedef size_t VibesHash;
+#else
+typedef uint VibesHash;
+#endif
+
+/// Style properties of an item, as given in JSON
+struct VibesStyleKey
+{
+    QString edgeColor, faceColor, lineStyle, lineWidth;
+
+    bool operator==(const VibesStyleKey &other) const {
+        return edgeColor == other.edgeColor && faceColor == other.faceColor
+                && lineStyle == other.lineStyle && lineWidth == other.lineWidth;
+    }
+};
+
+inline VibesHash qHash(const VibesStyleKey &key, VibesHash seed = 0)
+{
+    return seed ^ qHash(key.edgeColor) ^ (qHash(key.faceColor) * 31) ^ (qHash(key.lineStyle) * 17) ^ (qHash(key.lineWidth) * 13);
+}
+
+/// Pen and brush resolved from style properties, shared by all the items with the same style
+struct VibesStyle
+{
+    VibesStyleKey properties;
+    QPen pen;
+    QBrush brush;
+};
+
 // Singleton class to hold Vibes defaults and constants
 class VibesDefaults {
     QHash<QString, QBrush> _brushes;
@@ -48,67 +84,124 @@ public:
 
     //>[#142]
     // Hexadecimal/Short color name -> Qt Predefined color name
-    bool toPredefinedColorName(QString &color){
-
-        QString colorU = color.toUpper();
-        QString colorL = color.toLower();
-
-        if     (colorL.compare("none")   ==0){ color="transparent"; }
-        else if(colorU.compare("#0000FF")==0){ color="blue"; }
-        else if(colorL.compare("b")      ==0){ color="blue"; }
-        else if(colorU.compare("#00FFFF")==0){ color="cyan"; }
-        else if(colorL.compare("c")      ==0){ color="cyan"; }
-        else if(colorU.compare("#00FF00")==0){ color="green"; }
-        else if(colorL.compare("g")      ==0){ color="green"; }
-        else if(colorU.compare("#FFFF00")==0){ color="yellow"; }
-        else if(colorL.compare("y")      ==0){ color="yellow"; }
-        else if(colorU.compare("#FF0000")==0){ color="red"; }
-        else if(colorL.compare("r")      ==0){ color="red"; }
-        else if(colorU.compare("#FF00FF")==0){ color="magenta"; }
-        else if(colorL.compare("m")      ==0){ color="magenta"; }
-        else if(colorU.compare("#FFFFFF")==0){ color="white"; }
-        else if(colorL.compare("w")      ==0){ color="white"; }
-        else if(colorU.compare("#000000")==0){ color="black"; }
-        else if(colorL.compare("k")      ==0){ color="black"; }
-        else if(colorU.compare("#C0C0C0")==0){ color="lightGray"; }
-        else if(colorU.compare("#A0A0A4")==0){ color="gray"; }
-        else if(colorU.compare("#808080")==0){ color="darkGray"; }
-        else if(colorU.compare("#000080")==0){ color="darkBlue"; }
-        else if(colorU.compare("#008080")==0){ color="darkCyan"; }
-        else if(colorU.compare("#008000")==0){ color="darkGreen"; }
-        else if(colorU.compare("#808000")==0){ color="darkYellow"; }
-        else if(colorU.compare("#800000")==0){ color="darkRed"; }
-        else if(colorU.compare("#800080")==0){ color="darkMagenta"; }
-        else                                 { return false; }
-
+    bool toPredefinedColorName(QString &color) const {
+        // Hexadecimal names are matched in upper case, short names in lower case
+        QHash<QString, QString>::const_iterator it =
+                _predefinedColorNames.find(color.startsWith('#') ? color.toUpper() : color.toLower());
+        if (it == _predefinedColorNames.constEnd())
+            return false;
+        color = it.value();
         return true;
     }
     //<[#142]
 
     const QBrush brush(const QString & name = QString()) {
-        if( !_brushes.contains(name)){
-            _brushes[name] = QBrush(parseColorName(name));
-        }
-        return _brushes[name];
+        QHash<QString, QBrush>::const_iterator it = _brushes.constFind(name);
+        if (it == _brushes.constEnd())
+            it = _brushes.insert(name, QBrush(parseColorName(name)));
+        return it.value();
     }
 
     const QPen pen(const QString & name = QString(),const QString & style = QString(),const QString & width = QString()) {
-        if( !_pens.contains(name)){
-            _pens[name] = QPen(parseColorName(name),0);
-        }
-        _pens[name].setStyle(parsePenStyle(style));
-        _pens[name].setWidthF(parsePenWidth(width));
-        return _pens[name];
+        QHash<QString, QPen>::const_iterator it = _pens.constFind(name);
+        if (it == _pens.constEnd())
+            it = _pens.insert(name, QPen(parseColorName(name),0));
+        // Cached pens are shared: style and width are set on a copy
+        QPen pen = it.value();
+        pen.setStyle(parsePenStyle(style));
+        pen.setWidthF(parsePenWidth(width));
+        return pen;
     }
 
+    /// Id of the style for the given properties, resolved to a pen and a brush the first time
+    int styleId(const QString & edgeColor, const QString & faceColor, const QString & lineStyle, const QString & lineWidth);
+    VibesStyle style(int id) const { return _styles.at(id); }
+
 private:
     VibesDefaults();
     static VibesDefaults _instance;
     void initDefaultBrushesAndPens();
+    void initPredefinedColorNames();
+
+    QHash<QString, QString> _predefinedColorNames;
+    // Interned styles
+    QHash<VibesStyleKey, int> _styleIds;
+    QVector<VibesStyle> _styles;
 };
 // Helper macro to access the VibesDefaults instance
 #define vibesDefaults VibesDefaults::instance()
 
+/// Maps scalar values to colors, through a table of colors interpolated between evenly spaced stops
+
+class VibesColorMap
+{
+    QVector<QRgb> _table;
+public:
+    /// Default color map ("viridis")
+    VibesColorMap();
+    /// A named map ("viridis", "jet", "hot", "gray") or an array of colors. Returns false if \a value is not one.
+    static bool fromJson(const QJsonValue &value, VibesColorMap &colorMap);
+
+    QRgb rgb(double value, double min, double max) const { QRgb color; map(&value, 1, min, max, &color); return color; }
+    /// Colors of count values, mapped from [min,max], in a single pass (values out of range are clamped)
+    void map(const double *values, int count, double min, double max, QRgb *colors) const;
+    /// Same, mapped from \a range ([min,max] array), or from the range of the values if it is not one
+    void map(const double *values, int count, const QJsonValue &range, QRgb *colors) const;
+
+private:
+    void setStops(const QStringList &colors);
+};
+
+/// Compact storage of a numeric JSON property: a vector or a matrix (array of rows of the
+/// same size), stored as a contiguous row-major array of doubles. A vector is a single row.
+class VibesMatrix
+{
+    int _rows, _cols;
+    bool _isVector;
+    QVector<double> _data;
+public:
+    VibesMatrix() : _rows(0), _cols(0), _isVector(false) {}
+
+    /// Converts a non-empty JSON vector or matrix of numbers. Returns false if \a value is not one.
+    static bool fromJson(const QJsonValue &value, VibesMatrix &matrix);
+    QJsonValue toJson() const;
+
+    int rows() const { return _rows; }
+    int cols() const { return _cols; }
+    bool isVector() const { return _isVector; }
+    bool isEmpty() const { return _data.isEmpty(); }
+    double at(int row, int col) const { return _data.at(row * _cols + col); }
+    const double * row(int row) const { return _data.constData() + row * _cols; }
+    const QVector<double> & data() const { return _data; }
+
+    /// Copies the given columns, one after the other (column c of the result starts at c*rows())
+    QVector<double> gather(const QVector<int> &columns) const;
+};
+
+/// Compact geometry of an item projected on (dimX, dimY): the coordinates needed for drawing,
+/// either gathered from a VibesMatrix as contiguous columns, or read in place from its storage.
+/// Element i of column c is column(c)[i * stride].
+struct VibesProjection
+{
+    int dimX, dimY;
+    int rows;
+    int stride;
+    bool gathered;
+    QVector<double> coords;
+    QVector<int> starts;
+
+    VibesProjection() : dimX(-1), dimY(-1), rows(0), stride(1), gathered(false) {}
+    bool isFor(int dimX, int dimY) const { return this->dimX == dimX && this->dimY == dimY; }
+    const double * column(int c) const { return coords.constData() + starts.value(c); }
+    /// Memory owned by the projection (a projection read in place shares the matrix storage)
+    qint64 bytes() const { return gathered ? coords.size() * sizeof(double) : 0; }
+
+    /// Projects the given columns of matrix (empty projection if a column does not exist)
+    static VibesProjection fromMatrix(const VibesMatrix &matrix, const QVector<int> &columns, int dimX, int dimY);
+    /// Same columns, read in place: no copy, but strided accesses
+    static VibesProjection inPlace(const VibesMatrix &matrix, const QVector<int> &columns, int dimX, int dimY);
+};
+
 class VibesGraphicsItem
 {
     // Pointer to the QGraphicsItem object. Used for casting.
@@ -138,6 +231,11 @@ public:
            VibesGraphicsBoxesUnionType,
            VibesGraphicsPointsType,
            VibesGraphicsTextType,
+           VibesGraphicsArrowsType,
+           VibesGraphicsPiesType,
+           VibesGraphicsEllipsesType,
+           VibesGraphicsPolylinesType,
+           VibesGraphicsHeatmapType,
            // Do not remove the following value! It signals the end of VibesGraphicsItem types
            VibesGraphicsLastType,
            VibesGraphicsRasterType,
@@ -147,11 +245,11 @@ public:
     // Constructor
     VibesGraphicsItem(QGraphicsItem * qGraphicsItem);
     // Destructor (virtual)
-    virtual ~VibesGraphicsItem() { setName(QString()); }
+    virtual ~VibesGraphicsItem() { setName(QString()); if (scene()) scene()->forgetItem(this); }
 
     bool setJson(QJsonObject json, int dimX, int dimY);
     bool setJson(QJsonObject json) { return setJson(json, _dimX, _dimY); }
-    const QJsonObject & json() const { return _json; }
+    QJsonObject json() const;
     QJsonValue jsonValue(const QString &key) const;
     void setJsonValue(const QString &key, const QJsonValue &value);
     void setJsonValues(const QJsonObject &values);
@@ -159,8 +257,43 @@ public:
     bool existsInProj(int dimX, int dimY) const { return hasDim(dimX) && hasDim(dimY); }
     bool setProj(int dimX, int dimY);
     bool updateProj() { return setProj(_dimX,_dimY); }
+    /// Computes the projection of the compact geometry, before setProj(). Only reads the item
+    /// own data and does not access the scene: can be called from a worker thread.
+    void prepareProj(int dimX, int dimY);
+    // Cache of projections, one per (dimX,dimY) pair. The revision changes with the geometry.
+    /// Matrix and columns to gather for the projection on (dimX,dimY). False if nothing to project.
+    bool projectionSource(int dimX, int dimY, VibesMatrix &matrix, QVector<int> &columns) const;
+    bool hasProjection(int dimX, int dimY) const { return _projections.contains(qMakePair(dimX, dimY)); }
+    void cacheProjection(const VibesProjection &projection, quint64 revision);
+    void dropProjection(int dimX, int dimY) { _projections.remove(qMakePair(dimX, dimY)); }
+    qint64 projectionBytes(int dimX, int dimY) const { return _projections.value(qMakePair(dimX, dimY)).bytes(); }
+    quint64 geometryRevision() const { return _geometryRevision; }
     int dimension() const { return maxDim(); }
-
+    // Current projection
+    int dimX() const { return _dimX; }
+    int dimY() const { return _dimY; }
+
+
+    // Interned style of the item, resolved from its (possibly inherited) style properties
+    int styleId();
+    VibesStyle style() { return vibesDefaults.style(styleId()); }
+    void invalidateStyle() { _styleId = -1; }
+    /// Sets style properties (e.g. from a group) and restyles the item, keeping its geometry when possible
+    virtual void setStyleValues(const QJsonObject &values);
+
+    // Deferred updates: changes mark the item dirty, and its graphics are rebuilt once by updateGraphics()
+    // (called by the scene before the next paint, or at the end of a batch of messages)
+    bool isDirty() const { return _dirtyGeometry || _dirtyStyle; }
+    void markDirty(bool geometry);
+    void updateGraphics();
+
+    /// Moves the item to (x,y) with heading (degrees) through its transform only: graphics are not rebuilt.
+    /// The pose replaces the "center" and "orientation" of the item, when it has them.
+    bool setPose(double x, double y, double heading);
+    void clearPose();
+    bool hasPose() const { return _hasPose; }
+    /// Current heading (degrees): the pose heading, or the orientation of the item when it has no pose
+    double poseHeading() const;
 
     QString name() const { return _name; }
     void setName(QString name) { if (name != this->name()) { _name=name; if (scene()) scene()->setItemName(this, this->name()); } }
@@ -175,6 +308,12 @@ protected:
     bool parseJson(QJsonObject &json);
     virtual bool parseJsonGraphics(const QJsonObject &json) = 0;
     virtual bool computeProjection(int dimX, int dimY) = 0;
+    // Applies the style to the graphics (rebuilds the projection by default)
+    virtual void updateStyle() { updateProj(); }
+    // Applies the style to the elements of a batch with their own colors (see VIBES_BATCH_STYLE)
+    virtual void updateElementColors() {}
+    // Pen to paint with: in draft mode, thin solid edges are the cheapest to draw
+    QPen paintPen(const QPen &pen) const;
     virtual bool hasDim(int n) const { return n>=0 && n<_nbDim; }
     virtual int maxDim() const { return _nbDim; }
     // Utility
@@ -183,10 +322,34 @@ protected:
     // Json Properties categories
     virtual bool propertyIsReadOnly(const QString & key) { if (key=="type") return true; else return false; }
     virtual bool propertyChangesGeometry(const QString & key) { return false; }
+    // Numeric properties kept in compact storage instead of the JSON object
+    virtual bool propertyIsCompact(const QString & key) { return false; }
+    VibesMatrix matrix(const QString & key) const { return _matrices.value(key); }
+    // Own colors of count elements, from their RGBA ("Colors") or their levels ("ColorLevels", mapped
+    // through "ColorMap" and "ColorRange"). Empty if the elements take the color of the item.
+    QVector<QRgb> elementColors(int count) const;
+    // Compact property and its columns holding the geometry on (dimX,dimY) (nothing to project by default)
+    virtual bool projectionColumns(int dimX, int dimY, QString & key, QVector<int> & columns) const { return false; }
+    VibesProjection projectGeometry(int dimX, int dimY) const;
+    // Cached projection for (dimX,dimY), or the compact geometry read in place if not cached
+    const VibesProjection & projection(int dimX, int dimY);
+    // Drops all cached projections, after a change of geometry
+    void invalidateProjections();
+    // Transform of the item from its drawn position to its pose, in the current projection
+    void applyPose();
 
 protected:
     QJsonObject _json;
+    QHash<QString, VibesMatrix> _matrices;
+    QHash<QPair<int,int>, VibesProjection> _projections;
+    VibesProjection _inPlaceProjection;
+    quint64 _geometryRevision;
+    static quint64 _lastGeometryRevision;
     int _nbDim;
+    int _styleId;
+    bool _dirtyGeometry, _dirtyStyle;
+    bool _hasPose;
+    double _poseX, _poseY, _poseHeading;
 };
 
 // Specialization of qgraphicsitem_cast to VibesGraphicsItem* base class (uses dynamic_cast)
@@ -238,6 +401,28 @@ protected: \
 inline bool propertyChangesGeometry(const QString& key) { \
     if (QStringList({__VA_ARGS__}).contains(key)) return true; \
     else return VibesGraphicsItem::propertyChangesGeometry(key); }
+#define VIBES_COMPACT_PROPERTIES(...) \
+protected: \
+inline bool propertyIsCompact(const QString& key) { \
+    if (QStringList({__VA_ARGS__}).contains(key)) return true; \
+    else return VibesGraphicsItem::propertyIsCompact(key); }
+// Macros for items whose style is only their pen (and brush): restyling keeps the geometry
+#define VIBES_PEN_STYLE \
+protected: \
+inline void updateStyle() { this->setPen(style().pen); }
+#define VIBES_PEN_AND_BRUSH_STYLE \
+protected: \
+inline void updateStyle() { \
+    const VibesStyle & style = this->style(); \
+    this->setPen(style.pen); this->setBrush(style.brush); }
+// A macro for batches: their bounding rect has a margin for the pen width, which rebuilds the projection
+// when it changes. Otherwise only the pen and brush (given by brush_expr) and the element colors change.
+#define VIBES_BATCH_STYLE(brush_expr) \
+protected: \
+inline void updateStyle() { \
+    const VibesStyle & style = this->style(); \
+    if (style.pen.widthF() != this->pen().widthF()) { updateProj(); return; } \
+    this->setPen(style.pen); this->setBrush(brush_expr); updateElementColors(); }
 
 /// A group of objects (a layer)
 
@@ -247,9 +432,11 @@ class VibesGraphicsGroup : public QGraphicsItemGroup, public VibesGraphicsItem
 public:
     void addToGroup(VibesGraphicsItem *item);
     void clear();
+    void setStyleValues(const QJsonObject &values);
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
     bool computeProjection(int dimX, int dimY) { return true; }
+    void updateStyle() {}
 };
 
 /// A box
@@ -257,6 +444,7 @@ protected:
 class VibesGraphicsBox : public QGraphicsRectItem, public VibesGraphicsItem
 {
     VIBES_GRAPHICS_ITEM(VibesGraphicsBox, QGraphicsRectItem)
+    VIBES_PEN_AND_BRUSH_STYLE
     VIBES_GEOMETRY_CHANGING_PROPERTIES("bounds")
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
@@ -265,13 +453,24 @@ protected:
 
 /// A set of boxes
 
-class VibesGraphicsBoxes : public QGraphicsItemGroup, public VibesGraphicsItem
+class VibesGraphicsBoxes : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
 {
-    VIBES_GRAPHICS_ITEM(VibesGraphicsBoxes, QGraphicsItemGroup)
+    VIBES_GRAPHICS_ITEM(VibesGraphicsBoxes, QAbstractGraphicsShapeItem)
+    VIBES_BATCH_STYLE(style.brush)
     VIBES_GEOMETRY_CHANGING_PROPERTIES("bounds")
+    VIBES_COMPACT_PROPERTIES("bounds","ColorLevels","Colors")
+public:
+    QRectF boundingRect() const { return _boundingRect; }
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
     bool computeProjection(int dimX, int dimY);
+    bool projectionColumns(int dimX, int dimY, QString & key, QVector<int> & columns) const;
+    void updateElementColors();
+private:
+    // Boxes are painted directly from the compact "bounds" matrix, filled with their own colors if any
+    QRectF _boundingRect;
+    QVector<QRgb> _colors;
 };
 
 /// The union of a set of boxes
@@ -279,10 +478,13 @@ protected:
 class VibesGraphicsBoxesUnion : public QGraphicsPathItem, public VibesGraphicsItem
 {
     VIBES_GRAPHICS_ITEM(VibesGraphicsBoxesUnion, QGraphicsPathItem)
+    VIBES_PEN_AND_BRUSH_STYLE
     VIBES_GEOMETRY_CHANGING_PROPERTIES("bounds")
+    VIBES_COMPACT_PROPERTIES("bounds")
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
     bool computeProjection(int dimX, int dimY);
+    bool projectionColumns(int dimX, int dimY, QString & key, QVector<int> & columns) const;
 };
 
 
@@ -291,7 +493,8 @@ protected:
 class VibesGraphicsEllipse : public QGraphicsEllipseItem, public VibesGraphicsItem
 {
     VIBES_GRAPHICS_ITEM(VibesGraphicsEllipse, QGraphicsEllipseItem)
-    VIBES_GEOMETRY_CHANGING_PROPERTIES("center","axis","orientation","covariance","sigma")
+    VIBES_PEN_AND_BRUSH_STYLE
+    VIBES_GEOMETRY_CHANGING_PROPERTIES("center","axis","orientation","covariance","sigma","angles")
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
     bool computeProjection(int dimX, int dimY);
@@ -305,10 +508,13 @@ protected:
 class VibesGraphicsLine : public QGraphicsPathItem, public VibesGraphicsItem
 {
     VIBES_GRAPHICS_ITEM(VibesGraphicsLine, QGraphicsPathItem)
+    VIBES_PEN_STYLE
     VIBES_GEOMETRY_CHANGING_PROPERTIES("points")
+    VIBES_COMPACT_PROPERTIES("points")
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
     bool computeProjection(int dimX, int dimY);
+    bool projectionColumns(int dimX, int dimY, QString & key, QVector<int> & columns) const;
 };
 
 /// A polygon
@@ -316,10 +522,13 @@ protected:
 class VibesGraphicsPolygon : public QGraphicsPolygonItem, public VibesGraphicsItem
 {
     VIBES_GRAPHICS_ITEM(VibesGraphicsPolygon, QGraphicsPolygonItem)
+    VIBES_PEN_AND_BRUSH_STYLE
     VIBES_GEOMETRY_CHANGING_PROPERTIES("bounds")
+    VIBES_COMPACT_PROPERTIES("bounds")
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
     bool computeProjection(int dimX, int dimY);
+    bool projectionColumns(int dimX, int dimY, QString & key, QVector<int> & columns) const;
 };
 
 /// A text
@@ -328,54 +537,130 @@ class VibesGraphicsText : public QGraphicsSimpleTextItem, public VibesGraphicsIt
 {
     VIBES_GRAPHICS_ITEM(VibesGraphicsText, QGraphicsSimpleTextItem)
     VIBES_GEOMETRY_CHANGING_PROPERTIES("position","text")
+public:
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
     bool computeProjection(int dimX, int dimY);
     // void contextMenuEvent(QGraphicsSceneContextMenuEvent *event);
 };
 
+/// Geometry of a glyph (vehicles and other fixed shapes), built once per shape type and shared by its items.
+/// Coordinates are glyph units: the glyph is centered on the origin and heads along +x.
+
+struct VibesGlyphPart
+{
+    // How a part is painted: with the style of the item, with the color of its pen, not at all, or fixed
+    enum Paint { ItemStyle, ItemPenColor, NoPaint, FixedPaint };
+    QPainterPath path;
+    Paint penPaint, brushPaint;
+    // Fixed pen (width in scene units, as the item pen) and brush
+    QPen fixedPen;
+    QBrush fixedBrush;
+    // Only drawn when the glyph is not rotated (e.g. text)
+    bool uprightOnly;
+    // Text parts are painted as a QGraphicsSimpleTextItem placed by textTransform (fixed pen in text units)
+    QString text;
+    QTransform textTransform;
+};
+
+struct VibesGlyph
+{
+    QVector<VibesGlyphPart> parts;
+    // Length of the glyph, in glyph units: items are scaled to their own length
+    double length;
+    // If not 0, the item pen width is multiplied by penLength / item length (see cake())
+    double penLength;
+    // Bounds of the parts, including the pens of text parts, and the widest fixed pen (scene units)
+    QRectF bounds;
+    double fixedPenWidth;
+
+    VibesGlyph() : length(1.), penLength(0.), fixedPenWidth(0.) {}
+    void addPart(const QPainterPath &path, VibesGlyphPart::Paint penPaint, VibesGlyphPart::Paint brushPaint,
+                 const QPen &fixedPen = QPen(), const QBrush &fixedBrush = QBrush(), bool uprightOnly = false);
+    void addText(const QString &text, const QTransform &transform, const QPen &pen, VibesGlyphPart::Paint brushPaint, bool uprightOnly);
+
+    static const VibesGlyph & vehicle();
+    static const VibesGlyph & vehicleAUV();
+    static const VibesGlyph & vehicleTank();
+    static const VibesGlyph & vehicleMotorBoat();
+    static const VibesGlyph & cake();
+};
+
+/// Placement of a shared glyph by an item: a transform, from "center", "length" and "orientation"
+
+struct VibesGlyphInstance
+{
+    const VibesGlyph *glyph;
+    QTransform transform;
+    double scale;
+    bool upright;
+    QRectF bounds;
+    // Width of the item pen in scene units
+    double penWidth;
+
+    VibesGlyphInstance() : glyph(0), scale(1.), upright(true), penWidth(0.) {}
+    bool place(const VibesGlyph &glyph, const QJsonObject &json, int dimX, int dimY, double penWidth);
+    // The pen of the item is given in scene units
+    void paint(QPainter *painter, const QPen &pen, const QBrush &brush) const;
+};
+
+// A macro for items drawn from a shared glyph: they only keep its placement, and their pen and brush
+#define VIBES_GLYPH_ITEM(glyph_name) \
+public: \
+    QRectF boundingRect() const { return _glyph.bounds; } \
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget * = 0) { _glyph.paint(painter, pen(), brush()); } \
+protected: \
+    bool computeProjection(int dimX, int dimY) { \
+        const VibesStyle & style = this->style(); \
+        this->prepareGeometryChange(); \
+        this->setPen(style.pen); this->setBrush(style.brush); \
+        return _glyph.place(VibesGlyph::glyph_name(), _json, dimX, dimY, style.pen.widthF()); } \
+private: \
+    VibesGlyphInstance _glyph;
+
 /// A simple vehicle (triangle)
 
-class VibesGraphicsVehicle : public QGraphicsItemGroup, public VibesGraphicsItem
+class VibesGraphicsVehicle : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
 {
-    VIBES_GRAPHICS_ITEM(VibesGraphicsVehicle, QGraphicsItemGroup)
+    VIBES_GRAPHICS_ITEM(VibesGraphicsVehicle, QAbstractGraphicsShapeItem)
     VIBES_GEOMETRY_CHANGING_PROPERTIES("center","length","orientation")
+    VIBES_GLYPH_ITEM(vehicle)
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
-    bool computeProjection(int dimX, int dimY);
 };
 
 /// A submarine vehicle type AUV (torpedo)
 
-class VibesGraphicsVehicleAUV : public QGraphicsItemGroup, public VibesGraphicsItem
+class VibesGraphicsVehicleAUV : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
 {
-    VIBES_GRAPHICS_ITEM(VibesGraphicsVehicleAUV, QGraphicsItemGroup)
+    VIBES_GRAPHICS_ITEM(VibesGraphicsVehicleAUV, QAbstractGraphicsShapeItem)
     VIBES_GEOMETRY_CHANGING_PROPERTIES("center","length","orientation")
+    VIBES_GLYPH_ITEM(vehicleAUV)
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
-    bool computeProjection(int dimX, int dimY);
 };
 
 /// A tank vehicle type
 
-class VibesGraphicsVehicleTank : public QGraphicsItemGroup, public VibesGraphicsItem
+class VibesGraphicsVehicleTank : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
 {
-    VIBES_GRAPHICS_ITEM(VibesGraphicsVehicleTank, QGraphicsItemGroup)
+    VIBES_GRAPHICS_ITEM(VibesGraphicsVehicleTank, QAbstractGraphicsShapeItem)
     VIBES_GEOMETRY_CHANGING_PROPERTIES("center","length","orientation")
+    VIBES_GLYPH_ITEM(vehicleTank)
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
-    bool computeProjection(int dimX, int dimY);
 };
 
 /// A tank vehicle type
 
-class VibesGraphicsVehicleMotorBoat : public QGraphicsItemGroup, public VibesGraphicsItem
+class VibesGraphicsVehicleMotorBoat : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
 {
-    VIBES_GRAPHICS_ITEM(VibesGraphicsVehicleMotorBoat, QGraphicsItemGroup)
+    VIBES_GRAPHICS_ITEM(VibesGraphicsVehicleMotorBoat, QAbstractGraphicsShapeItem)
     VIBES_GEOMETRY_CHANGING_PROPERTIES("center","length","orientation")
+    VIBES_GLYPH_ITEM(vehicleMotorBoat)
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
-    bool computeProjection(int dimX, int dimY);
 };
 
 /// An arrow
@@ -389,6 +674,28 @@ protected:
     bool computeProjection(int dimX, int dimY);
 };
 
+/// A set of arrows (vector field), painted by a single item
+
+class VibesGraphicsArrows : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
+{
+    VIBES_GRAPHICS_ITEM(VibesGraphicsArrows, QAbstractGraphicsShapeItem)
+    VIBES_GEOMETRY_CHANGING_PROPERTIES("origins","vectors","tip_length","ColorMap","ColorRange")
+    VIBES_COMPACT_PROPERTIES("origins","vectors")
+public:
+    QRectF boundingRect() const { return _boundingRect; }
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
+protected:
+    bool parseJsonGraphics(const QJsonObject &json);
+    bool computeProjection(int dimX, int dimY);
+private:
+    // Projected arrows: shaft, tip (4 points) and bounds of each arrow, and colors when colored by magnitude
+    QVector<QLineF> _shafts;
+    QVector<QPointF> _tips;
+    QVector<QRectF> _arrowBounds;
+    QVector<QRgb> _colors;
+    QRectF _boundingRect;
+};
+
 /// A Pie
 
 class VibesGraphicsPie : public QGraphicsItemGroup, public VibesGraphicsItem
@@ -400,24 +707,116 @@ protected:
     bool computeProjection(int dimX, int dimY);
 };
 
+/// A set of lines ("lines") or polygons ("polygons"), painted by a single item. Their points are
+/// stored one after the other in a flat array of coordinates, and split by an array of offsets.
+
+class VibesGraphicsPolylines : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
+{
+    VIBES_GRAPHICS_ITEM(VibesGraphicsPolylines, QAbstractGraphicsShapeItem)
+    VIBES_BATCH_STYLE(_closed ? style.brush : QBrush(Qt::NoBrush))
+    VIBES_GEOMETRY_CHANGING_PROPERTIES("coordinates","offsets","dimension")
+    VIBES_COMPACT_PROPERTIES("coordinates","offsets")
+public:
+    QRectF boundingRect() const { return _boundingRect; }
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
+protected:
+    bool parseJsonGraphics(const QJsonObject &json);
+    bool computeProjection(int dimX, int dimY);
+private:
+    // Projected points of all the polylines, and index of the first point of each one (plus the end)
+    QVector<QPointF> _points;
+    QVector<int> _offsets;
+    QVector<QRectF> _polylineBounds;
+    bool _closed;
+    QRectF _boundingRect;
+};
+
+/// A set of confidence ellipses, painted by a single item
+
+class VibesGraphicsEllipses : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
+{
+    VIBES_GRAPHICS_ITEM(VibesGraphicsEllipses, QAbstractGraphicsShapeItem)
+    VIBES_BATCH_STYLE(style.brush)
+    VIBES_GEOMETRY_CHANGING_PROPERTIES("centers","covariances","sigma")
+    VIBES_COMPACT_PROPERTIES("centers","covariances")
+public:
+    QRectF boundingRect() const { return _boundingRect; }
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
+protected:
+    bool parseJsonGraphics(const QJsonObject &json);
+    bool computeProjection(int dimX, int dimY);
+private:
+    // Projected ellipses, one column per coordinate: center (x,y), semi-major axis (x,y),
+    // semi-minor axis (x,y) and half extents (x,y)
+    enum { CenterX, CenterY, MajorX, MajorY, MinorX, MinorY, ExtentX, ExtentY, Columns };
+    int count() const { return _geometry.size() / Columns; }
+    const double * column(int c) const { return _geometry.constData() + c * count(); }
+    QVector<double> _geometry;
+    // Unit circles with 8, 16, ..., 256 segments, shared by all ellipses
+    QVector<QPolygonF> _unitCircles;
+    QRectF _boundingRect;
+};
+
+/// A set of pies (and rings), painted by a single item
+
+class VibesGraphicsPies : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
+{
+    VIBES_GRAPHICS_ITEM(VibesGraphicsPies, QAbstractGraphicsShapeItem)
+    VIBES_BATCH_STYLE(style.brush)
+    VIBES_GEOMETRY_CHANGING_PROPERTIES("centers","rho","theta")
+    VIBES_COMPACT_PROPERTIES("centers","rho","theta")
+public:
+    QRectF boundingRect() const { return _boundingRect; }
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
+protected:
+    bool parseJsonGraphics(const QJsonObject &json);
+    bool computeProjection(int dimX, int dimY);
+private:
+    // Tessellates pie i for the given zoom level
+    void tessellate(int i, int level);
+
+    // Bounds of each pie, and its outline (with the inner circle of rings as a hole), tessellated
+    // for the zoom level it was last painted at (pies are tessellated again only when it changes)
+    QVector<QRectF> _pieBounds;
+    QVector<QPolygonF> _outlines;
+    QVector<QPolygonF> _holes;
+    QVector<int> _levels;
+    QRectF _boundingRect;
+};
+
 /// A Point
 class VibesGraphicsPoint : public QGraphicsEllipseItem, public VibesGraphicsItem
 {
     VIBES_GRAPHICS_ITEM(VibesGraphicsPoint, QGraphicsEllipseItem)
     VIBES_GEOMETRY_CHANGING_PROPERTIES("point");
+public:
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
     bool computeProjection(int dimX, int dimY);
 };
 
-/// A group of points
-class VibesGraphicsPoints : public QGraphicsItemGroup, public VibesGraphicsItem
+/// A set of points, painted by a single item
+class VibesGraphicsPoints : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
 {
-    VIBES_GRAPHICS_ITEM(VibesGraphicsPoints, QGraphicsItemGroup)
-    VIBES_GEOMETRY_CHANGING_PROPERTIES("centers")
+    VIBES_GRAPHICS_ITEM(VibesGraphicsPoints, QAbstractGraphicsShapeItem)
+    VIBES_BATCH_STYLE(style.brush)
+    VIBES_GEOMETRY_CHANGING_PROPERTIES("centers","Radius","Radiuses","FixedScale")
+    VIBES_COMPACT_PROPERTIES("centers","Radiuses","ColorLevels","Colors")
+public:
+    QRectF boundingRect() const { return _boundingRect; }
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
     bool computeProjection(int dimX, int dimY);
+    bool projectionColumns(int dimX, int dimY, QString & key, QVector<int> & columns) const;
+    void updateElementColors();
+private:
+    // Radius of each point (in pixels for fixed scale points), and own colors if any
+    QVector<double> _radiuses;
+    QVector<QRgb> _colors;
+    bool _fixedScale;
+    QRectF _boundingRect;
 };
 
 class VibesGraphicsRing : public QGraphicsItemGroup, public VibesGraphicsItem
@@ -438,13 +837,36 @@ protected:
     bool computeProjection(int dimX, int dimY);
 };
 
-class VibesGraphicsCake : public QGraphicsItemGroup, public VibesGraphicsItem
+/// A heatmap: a matrix of values mapped to colors, shown as an image over its bounds in the world.
+/// Row 0 of the matrix is the top of the image.
+class VibesGraphicsHeatmap : public QGraphicsItem, public VibesGraphicsItem
 {
-    VIBES_GRAPHICS_ITEM(VibesGraphicsCake, QGraphicsItemGroup)
-    VIBES_GEOMETRY_CHANGING_PROPERTIES("center","length","orientation")
+    VIBES_GRAPHICS_ITEM(VibesGraphicsHeatmap, QGraphicsItem)
+    VIBES_GEOMETRY_CHANGING_PROPERTIES("data","bounds")
+    VIBES_COMPACT_PROPERTIES("data")
+public:
+    QRectF boundingRect() const { return _rect; }
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = 0);
 protected:
     bool parseJsonGraphics(const QJsonObject &json);
     bool computeProjection(int dimX, int dimY);
+    void updateStyle();
+private:
+    // Maps the data to the pixels of the image, in place when the image has the size of the data
+    void updateImage();
+    // Transform from the image pixels to the world
+    QTransform imageTransform() const;
+    QImage _image;
+    QRectF _rect;
+};
+
+class VibesGraphicsCake : public QAbstractGraphicsShapeItem, public VibesGraphicsItem
+{
+    VIBES_GRAPHICS_ITEM(VibesGraphicsCake, QAbstractGraphicsShapeItem)
+    VIBES_GEOMETRY_CHANGING_PROPERTIES("center","length","orientation")
+    VIBES_GLYPH_ITEM(cake)
+protected:
+    bool parseJsonGraphics(const QJsonObject &json);
 };
 
 #endif // VIBESGRAPHICSITEM_H
@@ -5,15 +5,40 @@
 #include <QJsonValue>
 
 #include <QtCore>
+#include <QtConcurrent>
 
 #include "vibesgraphicsitem.h"
 
+#include <algorithm>
+#include <climits>
+
+/// Projection of an item gathered in a worker thread, from a copy of its compact geometry
+
+struct VibesScene2D::ProjectionJob
+{
+    VibesGraphicsItem *item;
+    quint64 revision;
+    VibesMatrix matrix;
+    QVector<int> columns;
+    int dimX, dimY;
+    VibesProjection projection;
+};
+
 /// Default Constructor
 
 VibesScene2D::VibesScene2D(QObject *parent) :
     QGraphicsScene(parent),
-    _dimX(0), _dimY(1), _nbDim(2)
+    _dimX(0), _dimY(1), _nbDim(2),
+    _draft(false),
+    _deleting(false),
+    _nameIndexBuilt(false),
+    _boundsDirty(false),
+    _updateScheduled(false),
+    _projectionCacheSize(64 * 1024 * 1024),
+    _speculation(new QFutureWatcher<void>(this))
 {
+    _cachedProjections << qMakePair(_dimX, _dimY);
+    connect(_speculation, SIGNAL(finished()), this, SLOT(cacheSpeculativeProjections()));
 }
 
 /// Destructor
@@ -26,8 +51,13 @@ VibesScene2D::~VibesScene2D()
     // since VibesScene2D is destructed before QGraphicsScene, the hash _namedItems
     // would not exist anymore when QGraphicsScene destructor would destroy the items
 
-    foreach (QGraphicsItem* item, this->items())
-        delete item;
+    // Views of the named items are not notified item by item
+    blockSignals(true);
+    clearItems();
+
+    // Workers only use their own copies of the geometry, but the jobs are owned by the scene
+    _speculation->waitForFinished();
+    qDeleteAll(_speculationJobs);
 }
 
 
@@ -97,31 +127,135 @@ void VibesScene2D::addVibesItem(VibesGraphicsItem *item)
     _nbDim = qMax(_nbDim, item->dimension());
     // Add item to the scene
     this->addItem(vibesgraphicsitem_cast<QGraphicsItem*>(item));
+    // Build its graphics with the next update
+    if (item->isDirty())
+        scheduleUpdate(item);
     // Update list of named objects
     this->setItemName(item, item->name());
 }
 
+void VibesScene2D::deleteItems(const QList<QGraphicsItem*> &items)
+{
+    if (items.isEmpty())
+        return;
+
+    // Items nested in other deleted items are deleted with them
+#if QT_VERSION >= 0x050E00
+    const QSet<QGraphicsItem*> deleted(items.begin(), items.end());
+#else
+    const QSet<QGraphicsItem*> deleted = items.toSet();
+#endif
+    QList<QGraphicsItem*> roots;
+    foreach (QGraphicsItem *item, items)
+    {
+        QGraphicsItem *parent = item->parentItem();
+        while (parent && !deleted.contains(parent))
+            parent = parent->parentItem();
+        if (!parent)
+            roots << item;
+    }
+
+    // Items and all their descendants
+    QList<QGraphicsItem*> subtree = roots;
+    for (int i = 0; i < subtree.size(); ++i)
+        subtree << subtree.at(i)->childItems();
+
+    // Items are unregistered here (not on deletion), so types beyond VibesGraphicsLastType are included
+    QSet<VibesGraphicsItem*> removed;
+    foreach (QGraphicsItem *item, subtree)
+    {
+        if (VibesGraphicsItem * vibesItem = dynamic_cast<VibesGraphicsItem*>(item))
+            removed.insert(vibesItem);
+    }
+    removeNamedItems(removed);
+    foreach (VibesGraphicsItem *item, removed)
+    {
+        _dirtyItems.remove(item);
+        _zoomDependentItems.remove(item);
+        if (_itemBounds.remove(item))
+            _boundsDirty = true;
+    }
+
+    // Last children first: their parent removes them from its children list in constant time
+    _deleting = true;
+    for (int i = roots.size() - 1; i >= 0; --i)
+        delete roots.at(i);
+    _deleting = false;
+}
+
+void VibesScene2D::clearItems()
+{
+    if (!_namedItems.isEmpty())
+    {
+        emit namedItemsAboutToBeReset();
+        _namedItems.clear();
+        _nameRows.clear();
+        _itemRows.clear();
+        _nameIndex.clear();
+        emit namedItemsReset();
+    }
+    _itemBounds.clear();
+    _bounds = QRectF();
+    _boundsDirty = false;
+    _dirtyItems.clear();
+    _zoomDependentItems.clear();
+
+    // The scene drops its index once, then deletes the items
+    _deleting = true;
+    this->clear();
+    _deleting = false;
+}
+
 void VibesScene2D::setItemName(VibesGraphicsItem *item, QString name)
 {
+    // Items deleted in bulk are already unregistered
+    if (_deleting)
+        return;
+
     // If needed, unname existing item with the same name
-    if (VibesGraphicsItem *old_item = itemByName(name))
+    const int oldRow = _nameRows.value(name, -1);
+    if (oldRow >= 0 && _namedItems.at(oldRow).item != item)
     {
-        // Nothing to do if the name already points to the good item
-        if (old_item != item)
-        {
-            // Unname previous item
-            old_item->setName(QString());
-        }
+        // Unname previous item (removes its row)
+        _namedItems.at(oldRow).item->setName(QString());
     }
-    
-    // If needed, remove existing entry for the item
-    _namedItems.remove(_namedItems.key(item));
-    
-    // Update named items list
-    if (!name.isEmpty())
+
+    if (item)
     {
-        _namedItems[name] = item;
+        const int row = _itemRows.value(item, -1);
+        if (row >= 0 && name.isEmpty())
+        {
+            removeNamedRow(row);
+        }
+        else if (row >= 0 && _namedItems.at(row).name != name)
+        {
+            // Rename in place
+            _nameRows.remove(_namedItems.at(row).name);
+            if (_nameIndexBuilt)
+            {
+                _nameIndex.remove(_namedItems.at(row).name);
+                _nameIndex.insert(name, item);
+            }
+            _namedItems[row].name = name;
+            _nameRows[name] = row;
+            emit namedItemChanged(row);
+        }
+        else if (row < 0 && !name.isEmpty())
+        {
+            NamedItem entry;
+            entry.name = name;
+            entry.item = item;
+            const int newRow = _namedItems.size();
+            emit namedItemAboutToBeInserted(newRow);
+            _namedItems.append(entry);
+            _nameRows[name] = newRow;
+            _itemRows[item] = newRow;
+            if (_nameIndexBuilt)
+                _nameIndex.insert(name, item);
+            emit namedItemInserted(newRow);
+        }
     }
+
     // Update new item if needed
     if (item && item->name() != name)
     {
@@ -129,6 +263,295 @@ void VibesScene2D::setItemName(VibesGraphicsItem *item, QString name)
     }
 }
 
+void VibesScene2D::removeNamedRow(int row)
+{
+    // The last row takes the place of the removed one, so that rows have no holes
+    const int last = _namedItems.size() - 1;
+    _nameRows.remove(_namedItems.at(row).name);
+    _itemRows.remove(_namedItems.at(row).item);
+    if (_nameIndexBuilt)
+        _nameIndex.remove(_namedItems.at(row).name);
+    if (row != last)
+    {
+        _namedItems[row] = _namedItems.at(last);
+        _nameRows[_namedItems.at(row).name] = row;
+        _itemRows[_namedItems.at(row).item] = row;
+        emit namedItemChanged(row);
+    }
+    emit namedItemAboutToBeRemoved(last);
+    _namedItems.removeLast();
+    emit namedItemRemoved(last);
+}
+
+void VibesScene2D::removeNamedItems(const QSet<VibesGraphicsItem*> &items)
+{
+    QVector<int> rows;
+    foreach (VibesGraphicsItem *item, items)
+    {
+        const int row = _itemRows.value(item, -1);
+        if (row >= 0)
+            rows << row;
+    }
+    if (rows.isEmpty())
+        return;
+
+    // A few rows are removed one by one, in decreasing order so that moved rows are not removed ones
+    if (rows.size() < _namedItems.size() / 2)
+    {
+        std::sort(rows.begin(), rows.end());
+        for (int i = rows.size() - 1; i >= 0; --i)
+            removeNamedRow(rows.at(i));
+        return;
+    }
+
+    // Otherwise the remaining rows are compacted in one pass, and views are reset
+    emit namedItemsAboutToBeReset();
+    int kept = 0;
+    for (int row = 0; row < _namedItems.size(); ++row)
+    {
+        if (!items.contains(_namedItems.at(row).item))
+            _namedItems[kept++] = _namedItems.at(row);
+    }
+    _namedItems.resize(kept);
+    _nameRows.clear();
+    _itemRows.clear();
+    for (int row = 0; row < kept; ++row)
+    {
+        _nameRows[_namedItems.at(row).name] = row;
+        _itemRows[_namedItems.at(row).item] = row;
+    }
+    _nameIndex.clear();
+    _nameIndexBuilt = false;
+    emit namedItemsReset();
+}
+
+// True if pattern contains glob wildcards
+static bool isWildcardPattern(const QString &pattern)
+{
+    return pattern.contains('*') || pattern.contains('?') || pattern.contains('[');
+}
+
+QList<VibesGraphicsItem*> VibesScene2D::selectItems(const QJsonObject &selector) const
+{
+    QList<VibesGraphicsItem*> selected;
+    const QString pattern = selector.value("name").toString();
+    const QString type = selector.value("type").toString();
+    const QString groupName = selector.value("group").toString();
+    // An empty selector does not select everything
+    if (pattern.isEmpty() && type.isEmpty() && groupName.isEmpty())
+        return selected;
+
+    // Candidates: the items nested in the group, or named items (from the registry or its index)
+    QList<VibesGraphicsItem*> candidates;
+    bool checkName = !pattern.isEmpty();
+    if (!groupName.isEmpty())
+    {
+        VibesGraphicsGroup *group = vibesgraphicsitem_cast<VibesGraphicsGroup*>(itemByName(groupName));
+        if (!group)
+            return selected;
+        QList<QGraphicsItem*> nested = group->childItems();
+        for (int i = 0; i < nested.size(); ++i)
+        {
+            nested << nested.at(i)->childItems();
+            if (VibesGraphicsItem * item = qgraphicsitem_cast<VibesGraphicsItem*>(nested.at(i)))
+                candidates << item;
+        }
+    }
+    else if (!pattern.isEmpty() && !isWildcardPattern(pattern))
+    {
+        if (VibesGraphicsItem * item = itemByName(pattern))
+            candidates << item;
+        checkName = false;
+    }
+    else if (pattern.endsWith('*') && !isWildcardPattern(pattern.left(pattern.size() - 1)))
+    {
+        // Prefix: only matching names are visited
+        foreach (const QString &name, namedItemsWithPrefix(pattern.left(pattern.size() - 1), INT_MAX))
+            candidates << namedItem(namedItemRow(name));
+        checkName = false;
+    }
+    else
+    {
+        foreach (const NamedItem &entry, _namedItems)
+            candidates << entry.item;
+    }
+
+#if QT_VERSION >= 0x050C00
+    const QRegularExpression glob(QRegularExpression::anchoredPattern(QRegularExpression::wildcardToRegularExpression(pattern)));
+#else
+    const QRegExp glob(pattern, Qt::CaseSensitive, QRegExp::Wildcard);
+#endif
+    foreach (VibesGraphicsItem *item, candidates)
+    {
+        if (!type.isEmpty() && item->jsonValue("type").toString() != type)
+            continue;
+        if (checkName && item->name() != pattern)
+        {
+#if QT_VERSION >= 0x050C00
+            if (!glob.match(item->name()).hasMatch())
+#else
+            if (!glob.exactMatch(item->name()))
+#endif
+                continue;
+        }
+        selected << item;
+    }
+    return selected;
+}
+
+VibesGraphicsItem * VibesScene2D::itemByName(const QString &name) const
+{
+    const int row = _nameRows.value(name, -1);
+    if (row >= 0)
+        return _namedItems.at(row).item;
+
+    // Group path: the item is found by its name, then its groups are checked
+    if (!name.contains('/'))
+        return 0;
+#if QT_VERSION >= 0x050E00
+    QStringList path = name.split('/', Qt::SkipEmptyParts);
+#else
+    QStringList path = name.split('/', QString::SkipEmptyParts);
+#endif
+    if (path.isEmpty())
+        return 0;
+    VibesGraphicsItem *item = itemByName(path.takeLast());
+    if (!item || itemPath(item) != path.join('/') + '/' + item->name())
+        return 0;
+    return item;
+}
+
+QStringList VibesScene2D::namedItemsWithPrefix(const QString &prefix, int limit, const QString &after) const
+{
+    // Names are only sorted when they are searched for the first time
+    if (!_nameIndexBuilt)
+    {
+        foreach (const NamedItem &entry, _namedItems)
+            _nameIndex.insert(entry.name, entry.item);
+        _nameIndexBuilt = true;
+    }
+
+    // Matching names are contiguous in the index: only the matches are visited
+    QStringList names;
+    QMap<QString, VibesGraphicsItem*>::const_iterator it = (after.isEmpty() || after < prefix)
+            ? _nameIndex.lowerBound(prefix) : _nameIndex.upperBound(after);
+    for (; it != _nameIndex.constEnd() && names.size() < limit && it.key().startsWith(prefix); ++it)
+        names << it.key();
+    return names;
+}
+
+QString VibesScene2D::itemPath(VibesGraphicsItem *item) const
+{
+    if (!item)
+        return QString();
+    QStringList path(item->name());
+    const QGraphicsItem *parent = vibesgraphicsitem_cast<QGraphicsItem*>(item)->parentItem();
+    for (; parent; parent = parent->parentItem())
+    {
+        const VibesGraphicsItem *group = qgraphicsitem_cast<const VibesGraphicsItem*>(parent);
+        if (group && !group->name().isEmpty())
+            path.prepend(group->name());
+    }
+    return path.join('/');
+}
+
+QRectF VibesScene2D::itemsBounds()
+{
+    updateDirtyItems();
+    // Only recomputed when an item on the border has moved inwards or has been removed
+    if (_boundsDirty)
+    {
+        _bounds = QRectF();
+        foreach (const QRectF &rect, _itemBounds)
+            _bounds |= rect;
+        _boundsDirty = false;
+    }
+    return _bounds;
+}
+
+void VibesScene2D::updateItemBounds(VibesGraphicsItem *item, bool visible)
+{
+    QGraphicsItem *graphicsItem = vibesgraphicsitem_cast<QGraphicsItem*>(item);
+    // Groups are bounded by their children
+    if (!graphicsItem || graphicsItem->type() == VibesGraphicsItem::VibesGraphicsGroupType)
+        return;
+
+    const QRectF previous = _itemBounds.value(item);
+    const QRectF rect = visible ? graphicsItem->sceneBoundingRect() : QRectF();
+    if (rect.isNull())
+        _itemBounds.remove(item);
+    else
+        _itemBounds[item] = rect;
+
+    // The scene rect is set from the bounds (see updateDims): grow it with them, so that
+    // items drawn afterwards can still be scrolled to
+    if (!rect.isNull() && !sceneRect().contains(rect))
+        setSceneRect(sceneRect() | rect);
+
+    if (_boundsDirty)
+        return;
+    // Bounds can shrink only if the previous rect was on their border
+    if (!previous.isNull() && !rect.contains(previous)
+            && (previous.left() <= _bounds.left() || previous.right() >= _bounds.right()
+                || previous.top() <= _bounds.top() || previous.bottom() >= _bounds.bottom()))
+        _boundsDirty = true;
+    else
+        _bounds |= rect;
+}
+
+void VibesScene2D::forgetItem(VibesGraphicsItem *item)
+{
+    if (_deleting)
+        return;
+    _dirtyItems.remove(item);
+    _zoomDependentItems.remove(item);
+    // Only uses the stored rect: the item may be partially destroyed
+    if (!_itemBounds.contains(item))
+        return;
+    const QRectF previous = _itemBounds.take(item);
+    if (previous.left() <= _bounds.left() || previous.right() >= _bounds.right()
+            || previous.top() <= _bounds.top() || previous.bottom() >= _bounds.bottom())
+        _boundsDirty = true;
+}
+
+void VibesScene2D::scheduleUpdate(VibesGraphicsItem *item)
+{
+    _dirtyItems.insert(item);
+    // Queued: runs once control returns to the event loop, before the next paint
+    if (!_updateScheduled)
+    {
+        _updateScheduled = true;
+        QMetaObject::invokeMethod(this, "updateDirtyItems", Qt::QueuedConnection);
+    }
+}
+
+void VibesScene2D::setZoomDependent(VibesGraphicsItem *item, bool dependent)
+{
+    if (dependent)
+        _zoomDependentItems.insert(item);
+    else
+        _zoomDependentItems.remove(item);
+}
+
+void VibesScene2D::viewZoomChanged()
+{
+    foreach (VibesGraphicsItem *item, _zoomDependentItems)
+        item->markDirty(true);
+}
+
+void VibesScene2D::updateDirtyItems()
+{
+    _updateScheduled = false;
+    // Rebuilding a group may dirty its children
+    while (!_dirtyItems.isEmpty())
+    {
+        QSet<VibesGraphicsItem*> items = _dirtyItems;
+        _dirtyItems.clear();
+        foreach (VibesGraphicsItem *item, items)
+            item->updateGraphics();
+    }
+}
+
 bool VibesScene2D::setDimX(int dimX)
 {
     if (dimX>=0 && dimX<nbDim() && dimX!=this->dimX() && dimX!=dimY())
@@ -187,15 +610,168 @@ bool VibesScene2D::setDims(int dimX, int dimY)
 void VibesScene2D::updateDims()
 {
     QList<QGraphicsItem*> children = this->items();
+    QList<VibesGraphicsItem*> vibesItems;
     foreach(QGraphicsItem *item, children)
     {
         if (VibesGraphicsItem * vibesItem = qgraphicsitem_cast<VibesGraphicsItem*>(item))
+            vibesItems << vibesItem;
+    }
+
+    // Gather projected coordinates of all items in parallel (no scene or item geometry is touched).
+    // Without a cache, items read their compact geometry in place instead.
+    const int dimX = this->dimX(), dimY = this->dimY();
+    if (_projectionCacheSize > 0)
+    {
+        QtConcurrent::blockingMap(vibesItems, [dimX, dimY](VibesGraphicsItem *vibesItem) {
+            vibesItem->prepareProj(dimX, dimY);
+        });
+    }
+
+    // Build graphics from the projections in the GUI thread
+    foreach(VibesGraphicsItem *vibesItem, vibesItems)
+    {
+        QGraphicsItem *item = vibesgraphicsitem_cast<QGraphicsItem*>(vibesItem);
+        if ( vibesItem->setProj(dimX,dimY) )
+            item->setVisible(true);
+        else
+            item->setVisible(false);
+    }
+    // All items are up to date
+    _dirtyItems.clear();
+    setSceneRect(itemsBounds());
+
+    // The current projection becomes the most recently used one
+    _cachedProjections.removeAll(qMakePair(dimX, dimY));
+    _cachedProjections.prepend(qMakePair(dimX, dimY));
+    trimProjectionCache();
+    speculateProjections();
+}
+
+void VibesScene2D::setProjectionCacheSize(int megabytes)
+{
+    _projectionCacheSize = qMax(0, megabytes) * qint64(1024 * 1024);
+    trimProjectionCache();
+}
+
+void VibesScene2D::trimProjectionCache()
+{
+    QList<VibesGraphicsItem*> vibesItems;
+    foreach(QGraphicsItem *item, this->items())
+    {
+        if (VibesGraphicsItem * vibesItem = qgraphicsitem_cast<VibesGraphicsItem*>(item))
+            vibesItems << vibesItem;
+    }
+
+    // Memory used by each cached projection
+    QList<qint64> bytes;
+    qint64 total = 0;
+    foreach(const QPair<int,int> &dims, _cachedProjections)
+    {
+        qint64 size = 0;
+        foreach(VibesGraphicsItem *vibesItem, vibesItems)
+            size += vibesItem->projectionBytes(dims.first, dims.second);
+        bytes << size;
+        total += size;
+    }
+
+    // Evict least recently used projections. Items fall back to their compact geometry
+    // when the current one is evicted too.
+    while (total > _projectionCacheSize && !_cachedProjections.isEmpty())
+    {
+        const QPair<int,int> dims = _cachedProjections.takeLast();
+        total -= bytes.takeLast();
+        foreach(VibesGraphicsItem *vibesItem, vibesItems)
+            vibesItem->dropProjection(dims.first, dims.second);
+    }
+}
+
+void VibesScene2D::speculateProjections()
+{
+    if (_projectionCacheSize <= 0 || !_speculationJobs.isEmpty())
+        return;
+
+    // The projections likely to be picked next are the neighbours of the current one in the selectors
+    QList< QPair<int,int> > candidates;
+    candidates << qMakePair(dimX(), dimY()+1) << qMakePair(dimX(), dimY()-1)
+               << qMakePair(dimX()+1, dimY()) << qMakePair(dimX()-1, dimY());
+    QList< QPair<int,int> > next;
+    foreach(const QPair<int,int> &dims, candidates)
+    {
+        if (dims.first >= 0 && dims.first < nbDim() && dims.second >= 0 && dims.second < nbDim()
+                && dims.first != dims.second && !_cachedProjections.contains(dims))
+            next << dims;
+    }
+    if (next.isEmpty())
+        return;
+
+    // Copy the geometry to project (implicitly shared), so that items can change meanwhile
+    qint64 bytes = 0;
+    foreach(QGraphicsItem *item, this->items())
+    {
+        VibesGraphicsItem * vibesItem = qgraphicsitem_cast<VibesGraphicsItem*>(item);
+        if (!vibesItem) continue;
+        foreach(const QPair<int,int> &dims, next)
         {
-            if ( vibesItem->setProj(dimX(),dimY()) )
-                item->setVisible(true);
-            else
-                item->setVisible(false);
+            ProjectionJob *job = new ProjectionJob;
+            if (vibesItem->hasProjection(dims.first, dims.second)
+                    || !vibesItem->projectionSource(dims.first, dims.second, job->matrix, job->columns))
+            {
+                delete job;
+                continue;
+            }
+            job->item = vibesItem;
+            job->revision = vibesItem->geometryRevision();
+            job->dimX = dims.first;
+            job->dimY = dims.second;
+            bytes += qint64(job->matrix.rows()) * job->columns.size() * sizeof(double);
+            _speculationJobs << job;
         }
     }
-    setSceneRect(itemsBoundingRect());
+
+    // Do not speculate beyond the cache budget
+    qint64 cached = 0;
+    foreach(QGraphicsItem *item, this->items())
+    {
+        if (VibesGraphicsItem * vibesItem = qgraphicsitem_cast<VibesGraphicsItem*>(item))
+        {
+            foreach(const QPair<int,int> &dims, _cachedProjections)
+                cached += vibesItem->projectionBytes(dims.first, dims.second);
+        }
+    }
+    if (_speculationJobs.isEmpty() || cached + bytes > _projectionCacheSize)
+    {
+        qDeleteAll(_speculationJobs);
+        _speculationJobs.clear();
+        return;
+    }
+    _speculation->setFuture(QtConcurrent::map(_speculationJobs, gatherProjection));
+}
+
+void VibesScene2D::cacheSpeculativeProjections()
+{
+    // Items may have been deleted or changed while projecting: only keep projections of live items
+    QSet<VibesGraphicsItem*> liveItems;
+    foreach(QGraphicsItem *item, this->items())
+    {
+        if (VibesGraphicsItem * vibesItem = qgraphicsitem_cast<VibesGraphicsItem*>(item))
+            liveItems.insert(vibesItem);
+    }
+
+    foreach(ProjectionJob *job, _speculationJobs)
+    {
+        if (liveItems.contains(job->item))
+            job->item->cacheProjection(job->projection, job->revision);
+        const QPair<int,int> dims = qMakePair(job->dimX, job->dimY);
+        // Speculative projections are the first to be evicted
+        if (!_cachedProjections.contains(dims))
+            _cachedProjections.append(dims);
+    }
+    qDeleteAll(_speculationJobs);
+    _speculationJobs.clear();
+    trimProjectionCache();
+}
+
+void VibesScene2D::gatherProjection(ProjectionJob *job)
+{
+    job->projection = VibesProjection::fromMatrix(job->matrix, job->columns, job->dimX, job->dimY);
 }
@@ -3,6 +3,11 @@
 
 #include <QGraphicsScene>
 #include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QVector>
+#include <QPair>
+#include <QFutureWatcher>
 class QJsonObject;
 class VibesGraphicsItem;
 
@@ -12,17 +17,78 @@ class VibesScene2D : public QGraphicsScene
 
     int _dimX, _dimY;
     int _nbDim;
-    QHash<QString,VibesGraphicsItem *> _namedItems;
+    bool _draft;
+    // Set while items are deleted in bulk: their destructors do not need to unregister them
+    bool _deleting;
+    // Named items registry: rows without holes (removal moves the last row), with name -> row and item -> row
+    struct NamedItem
+    {
+        QString name;
+        VibesGraphicsItem *item;
+    };
+    QVector<NamedItem> _namedItems;
+    QHash<QString, int> _nameRows;
+    QHash<VibesGraphicsItem*, int> _itemRows;
+    // Sorted index of the names for prefix searches, built on first search then kept up to date
+    mutable QMap<QString, VibesGraphicsItem*> _nameIndex;
+    mutable bool _nameIndexBuilt;
     QHash<int, QString> _dimNames;
+
+    // Bounding rect of the items in the current projection, maintained as items change
+    QHash<VibesGraphicsItem*, QRectF> _itemBounds;
+    QRectF _bounds;
+    bool _boundsDirty;
+
+    // Items whose graphics need to be rebuilt
+    QSet<VibesGraphicsItem*> _dirtyItems;
+    bool _updateScheduled;
+    // Items whose bounds depend on the zoom of the views (sized in pixels)
+    QSet<VibesGraphicsItem*> _zoomDependentItems;
+
+    // Projections cached by the items, most recently used first, and the cache budget (bytes)
+    QList< QPair<int,int> > _cachedProjections;
+    qint64 _projectionCacheSize;
+    // Projections speculatively gathered in background threads
+    struct ProjectionJob;
+    QList<ProjectionJob*> _speculationJobs;
+    QFutureWatcher<void> *_speculation;
 public:
     explicit VibesScene2D(QObject *parent = 0);
     ~VibesScene2D();
     VibesGraphicsItem *addJsonShapeItem(const QJsonObject &shape);
 
     void addVibesItem(VibesGraphicsItem *item);
-    VibesGraphicsItem * itemByName(QString name) {if (_namedItems.contains(name)) return _namedItems[name]; else return 0;}
+    /// Deletes items with their children (items may be nested in each other). Their names,
+    /// bounds and pending updates are dropped in one pass, instead of item by item.
+    void deleteItems(const QList<QGraphicsItem*> &items);
+    /// Deletes all the items of the scene (to be used instead of clear())
+    void clearItems();
+    /// Named item, by name or by group path ("group/subgroup/name")
+    VibesGraphicsItem * itemByName(const QString &name) const;
     void setItemName(VibesGraphicsItem *item, QString name);
-    QList<QString> namedItems() const {return _namedItems.keys();}
+    // Iteration over named items, without copy
+    int namedItemCount() const { return _namedItems.size(); }
+    const QString & namedItemName(int row) const { return _namedItems.at(row).name; }
+    VibesGraphicsItem * namedItem(int row) const { return _namedItems.at(row).item; }
+    int namedItemRow(const QString &name) const { return _nameRows.value(name, -1); }
+    /// At most limit names starting with prefix, in alphabetical order, after the name after (if any)
+    QStringList namedItemsWithPrefix(const QString &prefix, int limit, const QString &after = QString()) const;
+    /// Items matching a selector: "name" (name or glob pattern, e.g. "robot*"), "group" (items nested
+    /// in a named group) and "type" (shape type). Criteria are combined; an empty selector selects nothing.
+    QList<VibesGraphicsItem*> selectItems(const QJsonObject &selector) const;
+    /// Names of the parent groups and of the item, separated by '/'
+    QString itemPath(VibesGraphicsItem *item) const;
+
+    /// Bounding rect of all the items visible in the current projection (replaces itemsBoundingRect())
+    QRectF itemsBounds();
+    /// To be called when the projected geometry of an item has changed
+    void updateItemBounds(VibesGraphicsItem *item, bool visible);
+    /// To be called when an item is removed from the scene
+    void forgetItem(VibesGraphicsItem *item);
+    /// Dirty items are rebuilt once, before the next paint or at the end of a batch (see updateDirtyItems())
+    void scheduleUpdate(VibesGraphicsItem *item);
+    /// Registers an item whose bounds must be computed again when a view is zoomed
+    void setZoomDependent(VibesGraphicsItem *item, bool dependent);
 
     const int nbDim() const { return _nbDim; }
     const int dimX() const { return _dimX; }
@@ -30,6 +96,14 @@ public:
 
     bool setDims(int dimX, int dimY);
 
+    // Draft mode: items may use a cheaper level of detail (e.g. while the view is being panned or zoomed)
+    bool isDraft() const { return _draft; }
+    void setDraft(bool draft) { _draft = draft; }
+
+    // Memory budget of the projections cache, in megabytes (0 disables the cache)
+    int projectionCacheSize() const { return _projectionCacheSize / (1024 * 1024); }
+    void setProjectionCacheSize(int megabytes);
+
     QString dimName(int dim) { if (dim<0 || dim>=nbDim()) return QString();
                                else if (_dimNames.contains(dim)) return _dimNames[dim];
                                else return QString("dim %1").arg(dim); }
@@ -38,13 +112,32 @@ signals:
     void changedDimX(int);
     void changedDimY(int);
     void dimensionsChanged();
+    // Changes of the named items rows
+    void namedItemAboutToBeInserted(int row);
+    void namedItemInserted(int row);
+    void namedItemAboutToBeRemoved(int row);
+    void namedItemRemoved(int row);
+    void namedItemChanged(int row);
+    void namedItemsAboutToBeReset();
+    void namedItemsReset();
 
 public slots:
     bool setDimX(int dimX);
     bool setDimY(int dimY);
+    void updateDirtyItems();
+    /// To be called by the views when their zoom has changed
+    void viewZoomChanged();
+
+private slots:
+    void cacheSpeculativeProjections();
 
 private:
+    void removeNamedRow(int row);
+    void removeNamedItems(const QSet<VibesGraphicsItem*> &items);
     void updateDims();
+    void trimProjectionCache();
+    void speculateProjections();
+    static void gatherProjection(ProjectionJob *job);
 };
 
 #endif // VIBESSCENE2D_H
@@ -2,49 +2,325 @@
 #include "vibesgraphicsitem.h"
 #include "figure2d.h"
 #include <QGraphicsItem>
+#include <QTimer>
 
-VibesTreeModel::VibesTreeModel(const QHash<QString, Figure2D *> &figures, QObject *parent) :
-    QAbstractItemModel(parent), figures(&figures)
+// Number of objects exposed to views at each fetch
+static const int fetchPageSize = 1000;
+
+VibesTreeModel::VibesTreeModel(QObject *parent) :
+    QAbstractItemModel(parent),
+    _forwarding(false),
+    _filterTimer(new QTimer(this))
 {
+    // Filtered objects are queried again once changes settle
+    _filterTimer->setSingleShot(true);
+    _filterTimer->setInterval(250);
+    connect(_filterTimer, SIGNAL(timeout()), this, SLOT(refreshFilter()));
 }
 
-QModelIndex VibesTreeModel::index(int row, int column, const QModelIndex &parent) const
+void VibesTreeModel::addFigure(Figure2D *figure, const QString &name)
 {
-    if (!hasIndex(row, column, parent))
-        return QModelIndex();
+    FigureEntry entry;
+    entry.figure = figure;
+    entry.scene = figure->scene();
+    entry.name = name;
+    entry.fetched = 0;
+    entry.fetchLimit = 0;
+    entry.moreMatches = !_filter.isEmpty();
 
- /*   const void *parentItem;
+    beginInsertRows(QModelIndex(), _figures.size(), _figures.size());
+    _figures.append(entry);
+    endInsertRows();
+    if (entry.moreMatches)
+        fetchMore(index(_figures.size() - 1, 0, QModelIndex()));
 
-    if (!parent.isValid())
-        parentItem = figures;
-    else
-        parentItem = parent.internalPointer();
+    // Follow the named objects of the figure
+    connect(entry.scene, SIGNAL(namedItemAboutToBeInserted(int)), this, SLOT(beginInsertObject(int)));
+    connect(entry.scene, SIGNAL(namedItemInserted(int)), this, SLOT(endInsertObject()));
+    connect(entry.scene, SIGNAL(namedItemAboutToBeRemoved(int)), this, SLOT(beginRemoveObject(int)));
+    connect(entry.scene, SIGNAL(namedItemRemoved(int)), this, SLOT(endRemoveObject()));
+    connect(entry.scene, SIGNAL(namedItemChanged(int)), this, SLOT(objectChanged(int)));
+    connect(entry.scene, SIGNAL(namedItemsAboutToBeReset()), this, SLOT(beginResetObjects()));
+    connect(entry.scene, SIGNAL(namedItemsReset()), this, SLOT(endResetObjects()));
+}
 
-    if (!parentItem)
-        return QModelIndex();
+void VibesTreeModel::removeFigure(Figure2D *figure)
+{
+    const int row = figureRow(figure);
+    if (row < 0)
+        return;
+    disconnect(_figures.at(row).scene, 0, this, 0);
+
+    beginRemoveRows(QModelIndex(), row, row);
+    _figures.removeAt(row);
+    endRemoveRows();
+}
 
-    if (parentItem == figures)
+Figure2D * VibesTreeModel::figure(const QModelIndex &index) const
+{
+    if (!index.isValid())
+        return 0;
+    if (index.internalPointer())
+        return static_cast<Figure2D*>(index.internalPointer());
+    return _figures.at(index.row()).figure;
+}
+
+VibesGraphicsItem * VibesTreeModel::object(const QModelIndex &index) const
+{
+    if (!index.isValid() || !index.internalPointer())
+        return 0;
+    const FigureEntry &entry = _figures.at(figureRow(static_cast<Figure2D*>(index.internalPointer())));
+    if (_filter.isEmpty())
+        return entry.scene->namedItem(index.row());
+    // Filtered names may be outdated until the next refresh
+    return entry.scene->itemByName(entry.matches.at(index.row()));
+}
+
+void VibesTreeModel::setFilter(const QString &prefix)
+{
+    if (prefix == _filter)
+        return;
+    _filterTimer->stop();
+    clearObjects();
+    _filter = prefix;
+    fetchFilteredObjects();
+}
+
+void VibesTreeModel::refreshFilter()
+{
+    clearObjects();
+    fetchFilteredObjects();
+}
+
+void VibesTreeModel::clearObjects()
+{
+    // Figures stay expanded: only their objects are removed
+    for (int row = 0; row < _figures.size(); ++row)
     {
-        if (row < figures->size())
-            return createIndex(row, column, figures->values().at(row));
-        else
-            return QModelIndex();
-    }*/
+        FigureEntry &entry = _figures[row];
+        const int count = _filter.isEmpty() ? entry.fetched : entry.matches.size();
+        if (count > 0)
+            beginRemoveRows(index(row, 0, QModelIndex()), 0, count - 1);
+        entry.fetched = 0;
+        entry.fetchLimit = 0;
+        entry.matches.clear();
+        entry.moreMatches = false;
+        if (count > 0)
+            endRemoveRows();
+    }
+}
 
+void VibesTreeModel::fetchFilteredObjects()
+{
+    // Without filter, objects are fetched when views need them
+    if (_filter.isEmpty())
+        return;
+    for (int row = 0; row < _figures.size(); ++row)
+    {
+        _figures[row].moreMatches = true;
+        fetchMore(index(row, 0, QModelIndex()));
+    }
+}
+
+bool VibesTreeModel::hasChildren(const QModelIndex &parent) const
+{
     if (!parent.isValid())
+        return !_figures.isEmpty();
+    if (parent.internalPointer())
+        return false;
+    // Figures show they have objects before these are fetched
+    const FigureEntry &entry = _figures.at(parent.row());
+    if (_filter.isEmpty())
+        return entry.scene->namedItemCount() > 0;
+    return !entry.matches.isEmpty() || entry.moreMatches;
+}
+
+bool VibesTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (!parent.isValid() || parent.internalPointer())
+        return false;
+    const FigureEntry &entry = _figures.at(parent.row());
+    if (_filter.isEmpty())
+        return entry.fetched < entry.scene->namedItemCount();
+    return entry.moreMatches;
+}
+
+void VibesTreeModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent))
+        return;
+    FigureEntry &entry = _figures[parent.row()];
+
+    if (_filter.isEmpty())
     {
-        if (row < figures->size())
-            return createIndex(row, column, (void*)0);
-        else
-            return QModelIndex();
+        // Next page of registry rows
+        entry.fetchLimit = entry.fetched + fetchPageSize;
+        const int count = qMin(entry.scene->namedItemCount(), entry.fetchLimit) - entry.fetched;
+        beginInsertRows(parent, entry.fetched, entry.fetched + count - 1);
+        entry.fetched += count;
+        endInsertRows();
+        return;
     }
 
-    if (parent.internalPointer() == 0)
+    // Next page of matching names, following the last one already shown
+    QStringList names = entry.scene->namedItemsWithPrefix(_filter, fetchPageSize + 1,
+                                                          entry.matches.isEmpty() ? QString() : entry.matches.last());
+    entry.moreMatches = (names.size() > fetchPageSize);
+    if (entry.moreMatches)
+        names.removeLast();
+    if (names.isEmpty())
+        return;
+    beginInsertRows(parent, entry.matches.size(), entry.matches.size() + names.size() - 1);
+    entry.matches << names;
+    endInsertRows();
+}
+
+int VibesTreeModel::figureRow(const Figure2D *figure) const
+{
+    for (int row = 0; row < _figures.size(); ++row)
+        if (_figures.at(row).figure == figure)
+            return row;
+    return -1;
+}
+
+int VibesTreeModel::sceneRow(const QObject *scene) const
+{
+    for (int row = 0; row < _figures.size(); ++row)
+        if (_figures.at(row).scene == scene)
+            return row;
+    return -1;
+}
+
+void VibesTreeModel::beginInsertObject(int row)
+{
+    const int figRow = sceneRow(sender());
+    if (figRow < 0)
+        return;
+    // Filtered objects are refreshed as a whole
+    if (!_filter.isEmpty())
+    {
+        if (!_filterTimer->isActive())
+            _filterTimer->start();
+        return;
+    }
+    // New rows are shown directly only while they fit in the fetched pages
+    const FigureEntry &entry = _figures.at(figRow);
+    if (row == entry.fetched && row < entry.fetchLimit)
     {
-        return createIndex(row, column, figures->values().at(parent.row()));
+        _forwarding = true;
+        beginInsertRows(index(figRow, 0, QModelIndex()), row, row);
     }
+}
 
+void VibesTreeModel::endInsertObject()
+{
+    if (!_forwarding)
+        return;
+    _forwarding = false;
+    ++_figures[sceneRow(sender())].fetched;
+    endInsertRows();
+}
 
+void VibesTreeModel::beginRemoveObject(int row)
+{
+    const int figRow = sceneRow(sender());
+    if (figRow < 0)
+        return;
+    if (!_filter.isEmpty())
+    {
+        if (!_filterTimer->isActive())
+            _filterTimer->start();
+        return;
+    }
+    if (row < _figures.at(figRow).fetched)
+    {
+        _forwarding = true;
+        beginRemoveRows(index(figRow, 0, QModelIndex()), row, row);
+    }
+}
+
+void VibesTreeModel::endRemoveObject()
+{
+    if (!_forwarding)
+        return;
+    _forwarding = false;
+    --_figures[sceneRow(sender())].fetched;
+    endRemoveRows();
+}
+
+void VibesTreeModel::objectChanged(int row)
+{
+    const int figRow = sceneRow(sender());
+    if (figRow < 0)
+        return;
+    if (!_filter.isEmpty())
+    {
+        if (!_filterTimer->isActive())
+            _filterTimer->start();
+        return;
+    }
+    if (row >= _figures.at(figRow).fetched)
+        return;
+    const QModelIndex changed = index(row, 0, index(figRow, 0, QModelIndex()));
+    emit dataChanged(changed, changed);
+}
+
+void VibesTreeModel::beginResetObjects()
+{
+    const int figRow = sceneRow(sender());
+    if (figRow < 0)
+        return;
+    if (!_filter.isEmpty())
+    {
+        if (!_filterTimer->isActive())
+            _filterTimer->start();
+        return;
+    }
+    // Fetched pages are kept: objects remaining or drawn again are shown directly
+    const int count = _figures.at(figRow).fetched;
+    if (count > 0)
+    {
+        _forwarding = true;
+        beginRemoveRows(index(figRow, 0, QModelIndex()), 0, count - 1);
+    }
+}
+
+void VibesTreeModel::endResetObjects()
+{
+    if (!_forwarding)
+        return;
+    _forwarding = false;
+    const int figRow = sceneRow(sender());
+    FigureEntry &entry = _figures[figRow];
+    entry.fetched = 0;
+    endRemoveRows();
+
+    // Remaining objects are shown again, up to the pages fetched before
+    const int count = qMin(entry.scene->namedItemCount(), entry.fetchLimit);
+    if (count > 0)
+    {
+        beginInsertRows(index(figRow, 0, QModelIndex()), 0, count - 1);
+        entry.fetched = count;
+        endInsertRows();
+    }
+}
+
+QModelIndex VibesTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent))
+        return QModelIndex();
+
+    // Figures have 0 as internal pointer
+    if (!parent.isValid())
+    {
+        return createIndex(row, column, (void*)0);
+    }
+
+    // Objects have their figure as internal pointer
+    if (parent.internalPointer() == 0)
+    {
+        return createIndex(row, column, _figures.at(parent.row()).figure);
+    }
 
     return QModelIndex();
 }
@@ -55,20 +331,13 @@ QModelIndex VibesTreeModel::parent(const QModelIndex &index) const
         return QModelIndex();
 
     // Parent of a figure is root
-    // figures have 0 as internal ptr
-    const void *childItem = index.internalPointer();
-    if (childItem == 0)
+    const Figure2D *figure = static_cast<const Figure2D*>(index.internalPointer());
+    if (figure == 0)
     {
         return QModelIndex();
     }
 
-/*    if (!figures->key(static_cast<Figure2D*>(index.internalPointer())).isEmpty())
-    {
-        return QModelIndex(0, 0, 0);
-    }
-    */
-    QList<Figure2D*> figPtrs = figures->values();
-    int row = figPtrs.indexOf(static_cast<Figure2D*>(index.internalPointer()));
+    int row = figureRow(figure);
     if (row >= 0)
     {
         return createIndex(row, 0, (void*)0);
@@ -81,29 +350,17 @@ int VibesTreeModel::rowCount(const QModelIndex &parent) const
 {
     if (parent.column() > 0)
         return 0;
-/*
-    const void *parentItem;
-    if (!parent.isValid())
-        parentItem = figures;
-    else
-        parentItem = parent.internalPointer();
-
-    if (parentItem == figures)
-    {
-        return figures->size();
-    }
-    */
 
     // root node
     if (!parent.isValid())
     {
-        return figures->size();
+        return _figures.size();
     }
     // figure node
     if (parent.internalPointer() == 0)
     {
-        Figure2D * fig = figures->values().at(parent.row());
-        return fig->scene()->namedItems().size();
+        const FigureEntry &entry = _figures.at(parent.row());
+        return _filter.isEmpty() ? entry.fetched : entry.matches.size();
     }
 
     return 0;
@@ -122,28 +379,29 @@ QVariant VibesTreeModel::data(const QModelIndex &index, int role) const
     if (!index.isValid())
         return QVariant();
 
+    const Figure2D *figure = static_cast<const Figure2D*>(index.internalPointer());
+
     if (role == Qt::DecorationRole)
     {
-        const void *childItem = index.internalPointer();
-        if (childItem == 0)
-        {
-            //return QColor(Qt::green);
-        }
-        if (const Figure2D* childFigure = static_cast<const Figure2D*>(childItem))
+        if (figure)
         {
             //If the group have a face color or a edge color, a square of that color will appear next to its name in the tree
-            VibesGraphicsItem * item = childFigure->scene()->itemByName(childFigure->scene()->namedItems().at(index.row()));
-            QString edgeColor = item->jsonValue("EdgeColor").toString();
-            QString faceColor = item->jsonValue("FaceColor").toString();
-            if(faceColor != "")
-            {
-                return QColor(faceColor);
-            }
-            else if(edgeColor != "")
+            VibesGraphicsItem *item = object(index);
+            if (!item)
+                return QVariant();
+            const int styleId = item->styleId();
+            QHash<int, QVariant>::const_iterator it = _decorations.constFind(styleId);
+            if (it == _decorations.constEnd())
             {
-                return QColor(edgeColor);
+                const VibesStyleKey properties = vibesDefaults.style(styleId).properties;
+                QVariant color;
+                if (!properties.faceColor.isEmpty())
+                    color = QColor(properties.faceColor);
+                else if (!properties.edgeColor.isEmpty())
+                    color = QColor(properties.edgeColor);
+                it = _decorations.insert(styleId, color);
             }
-            
+            return it.value();
         }
         return QVariant();
     }
@@ -151,22 +409,13 @@ QVariant VibesTreeModel::data(const QModelIndex &index, int role) const
     if (role != Qt::DisplayRole)
         return QVariant();
 
-    const void *childItem = index.internalPointer();
-    if (childItem == 0)
+    if (figure == 0)
     {
-        //return QVariant("Top level");
-        //return figures->key(const_cast<Figure2D*>(childFigure), "Unnamed figure");
-        Figure2D* fig = figures->values().at(index.row());
-        return figures->key(fig, "Unnamed figure");
+        const QString &name = _figures.at(index.row()).name;
+        return name.isEmpty() ? QString("Unnamed figure") : name;
     }
-    if (const Figure2D* childFigure = static_cast<const Figure2D*>(childItem))
-    {
-        //return figures->key(const_cast<Figure2D*>(childFigure), "Unnamed figure");
-        //return QString("id=%1 row=%2").arg(index.internalId()).arg(index.row());
-        return childFigure->scene()->namedItems().at(index.row());
-    }
-
-    return QVariant();
+    const FigureEntry &entry = _figures.at(figureRow(figure));
+    return _filter.isEmpty() ? entry.scene->namedItemName(index.row()) : entry.matches.at(index.row());
 }
 
 QVariant VibesTreeModel::headerData(int section, Qt::Orientation orientation,
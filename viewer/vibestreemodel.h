@@ -2,29 +2,89 @@
 #define VIBESMODEL_H
 
 #include <QAbstractItemModel>
+#include <QHash>
+#include <QList>
+#include <QStringList>
 
 class Figure2D;
+class VibesScene2D;
+class VibesGraphicsItem;
+class QTimer;
+
+/// Figures and their named objects. Figures are kept in the order they were added, and objects
+/// in the rows of the scene registry: changes are notified row by row, without model reset.
+///
+/// Objects are fetched by pages as the view needs them (canFetchMore/fetchMore). With a filter,
+/// figures only show the objects whose name starts with it, queried from the name index of the scene.
 
 class VibesTreeModel : public QAbstractItemModel
 {
     Q_OBJECT
 
-    const QHash<QString, Figure2D*> * figures;
+    struct FigureEntry
+    {
+        Figure2D *figure;
+        // Kept here: the scene of a figure being destroyed cannot be asked to the figure
+        VibesScene2D *scene;
+        QString name;
+        // Number of registry rows exposed to views, and up to which new rows are shown directly
+        int fetched;
+        int fetchLimit;
+        // Filtered objects exposed to views, and whether the index has more of them
+        QStringList matches;
+        bool moreMatches;
+    };
+    QList<FigureEntry> _figures;
+    // Decoration colors, by style id
+    mutable QHash<int, QVariant> _decorations;
+    QString _filter;
+    // Set while a change notified by a scene is forwarded to views
+    bool _forwarding;
+    QTimer *_filterTimer;
 public:
-    explicit VibesTreeModel(const QHash<QString, Figure2D *> &figures, QObject *parent = 0);
+    explicit VibesTreeModel(QObject *parent = 0);
     QModelIndex index(int row, int column, const QModelIndex &parent) const;
     QModelIndex parent(const QModelIndex &child) const;
     int rowCount(const QModelIndex &parent) const;
     int columnCount(const QModelIndex &parent) const;
     QVariant data(const QModelIndex &index, int role) const;
+    bool hasChildren(const QModelIndex &parent) const;
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
 
     QVariant headerData(int section, Qt::Orientation orientation, int role) const;
 
-    void forceUpdate() {beginResetModel();endResetModel();}
+    void addFigure(Figure2D *figure, const QString &name);
+    void removeFigure(Figure2D *figure);
+    /// Figure of a figure index, or of an object index
+    Figure2D * figure(const QModelIndex &index) const;
+    /// Named object of an object index (0 for a figure index)
+    VibesGraphicsItem * object(const QModelIndex &index) const;
+
+    const QString & filter() const { return _filter; }
 signals:
     
 public slots:
-    
+    /// Only shows the objects whose name starts with prefix (all objects if empty)
+    void setFilter(const QString &prefix);
+
+private slots:
+    void refreshFilter();
+    void beginInsertObject(int row);
+    void endInsertObject();
+    void beginRemoveObject(int row);
+    void endRemoveObject();
+    void objectChanged(int row);
+    void beginResetObjects();
+    void endResetObjects();
+
+private:
+    int figureRow(const Figure2D *figure) const;
+    int sceneRow(const QObject *scene) const;
+    // Removes the objects shown under every figure
+    void clearObjects();
+    // First page of filtered objects of every figure
+    void fetchFilteredObjects();
 };
 
 #endif // VIBESMODEL_H
@@ -26,7 +26,7 @@ ui(new Ui::VibesWindow),
 bRemoveFileOnExit(false)
 {
     ui->setupUi(this);
-    ui->treeView->setModel(new VibesTreeModel(figures, this));
+    ui->treeView->setModel(new VibesTreeModel(this));
 
     // When its name is double clicked in the list, the corresponding figure is brought to front
     /*connect(ui->treeView, &QTreeView::doubleClicked,
@@ -56,6 +56,8 @@ bRemoveFileOnExit(false)
     connect(ui->treeView, SIGNAL(showFigureEvent()),this,SLOT(showSingleGraphic()));
     // When P is pressed, the property editor is shown
     connect(ui->treeView, SIGNAL(propertiesEvent()),this,SLOT(editProperties()));
+    // Objects listed in the tree are filtered by the start of their name
+    connect(ui->filterEdit, SIGNAL(textChanged(QString)),this,SLOT(filterObjects(QString)));
     /// \todo Put platform dependent code here for named pipe creation and opening
     if (showFileOpenDlg)
     {
@@ -137,7 +139,7 @@ VibesWindow::newFigure(QString name)
 
     // Update figure list
     figures[name] = fig;
-    static_cast<VibesTreeModel*> (ui->treeView->model())->forceUpdate();
+    static_cast<VibesTreeModel*> (ui->treeView->model())->addFigure(fig, name);
     this->connect(fig, SIGNAL(destroyed(QObject*)), SLOT(removeFigureFromList(QObject*)));
 
     // Set flags to make it a window
@@ -156,8 +158,9 @@ void VibesWindow::removeFigureFromList(QObject* fig)
     if (it != figures.end() && it.value()==fig)
     {
         figures.erase(it);
-        static_cast<VibesTreeModel*> (ui->treeView->model())->forceUpdate();
     }
+    // Only compares pointers: the figure is being destroyed
+    static_cast<VibesTreeModel*> (ui->treeView->model())->removeFigure(static_cast<Figure2D*>(fig));
 }
 
 bool
@@ -226,9 +229,8 @@ VibesWindow::processMessage(const QByteArray &msg_data)
         else
         {
             // Clears the scene
-            fig->scene()->clear();
+            fig->scene()->clearItems();
         }
-        /// \todo Remove named objects references if needed
     }
         // Deletes a graphics item
     else if (action == "delete")
@@ -236,6 +238,15 @@ VibesWindow::processMessage(const QByteArray &msg_data)
         // Figure has to exist
         if (!fig)
             return false;
+        // Deletes every object matching the selector
+        if (msg.contains("selector"))
+        {
+            QList<QGraphicsItem*> items;
+            foreach (VibesGraphicsItem *item, fig->scene()->selectItems(msg.value("selector").toObject()))
+                items << vibesgraphicsitem_cast<QGraphicsItem*>(item);
+            fig->scene()->deleteItems(items);
+            return true;
+        }
         if (!msg.contains("object"))
             return false;
         // retrieve item by name
@@ -243,8 +254,50 @@ VibesWindow::processMessage(const QByteArray &msg_data)
         // if named item exists...
         if (!item)
             return false;
-        // ...delete it
-        delete item;
+        // ...delete it (with its children, if a group)
+        fig->scene()->deleteItems(QList<QGraphicsItem*>() << vibesgraphicsitem_cast<QGraphicsItem*>(item));
+    }
+        // Moves objects, without rebuilding their graphics
+    else if (action == "pose")
+    {
+        // Figure has to exist
+        if (!fig)
+            return false;
+        // A single object, or several objects with one pose each
+        QJsonArray objects, poses;
+        if (msg.contains("object"))
+        {
+            objects.append(msg.value("object"));
+            poses.append(msg.value("pose"));
+        }
+        else
+        {
+            objects = msg.value("objects").toArray();
+            poses = msg.value("poses").toArray();
+        }
+        if (objects.isEmpty() || objects.size() != poses.size())
+            return false;
+        // Pose is [x, y] (heading unchanged) or [x, y, heading]: malformed messages are not applied at all
+        foreach (const QJsonValue &value, poses)
+        {
+            const QJsonArray pose = value.toArray();
+            if (!value.isArray() || pose.size() < 2 || pose.size() > 3)
+                return false;
+            foreach (const QJsonValue &coord, pose)
+            {
+                if (!coord.isDouble())
+                    return false;
+            }
+        }
+        for (int i = 0; i < objects.size(); ++i)
+        {
+            VibesGraphicsItem * object = fig->scene()->itemByName(objects.at(i).toString());
+            if (!object)
+                continue;
+            const QJsonArray pose = poses.at(i).toArray();
+            const double heading = pose.size() > 2 ? pose.at(2).toDouble() : object->poseHeading();
+            object->setPose(pose.at(0).toDouble(), pose.at(1).toDouble(), heading);
+        }
     }
         // Export to a graphical file
     else if (action == "export")
@@ -281,12 +334,15 @@ VibesWindow::processMessage(const QByteArray &msg_data)
             VibesGraphicsItem * object = fig->scene()->itemByName(msg.value("object").toString());
             if (!object)
                 return false;
-            // Update properties
-            QJsonObject properties = msg.value("properties").toObject();
-            for (QJsonObject::const_iterator it = properties.constBegin(); it != properties.constEnd(); it++)
-            {
-                object->setJsonValue(it.key(), it.value());
-            }
+            // Update properties (graphics are rebuilt once, at the end of the batch)
+            object->setJsonValues(msg.value("properties").toObject());
+        }
+        // Set properties of every object matching the selector
+        else if (msg.contains("selector"))
+        {
+            const QJsonObject properties = msg.value("properties").toObject();
+            foreach (VibesGraphicsItem *object, fig->scene()->selectItems(msg.value("selector").toObject()))
+                object->setJsonValues(properties);
         }
         // else set figure properties
         else
@@ -324,16 +380,20 @@ VibesWindow::processMessage(const QByteArray &msg_data)
                         double ub_y = box[3].toDouble();
                         fig->setSceneRect(lb_x, lb_y, ub_x - lb_x, ub_y - lb_y);
                         fig->fitInView(fig->sceneRect());
+                        fig->notifyZoom();
                     }
                     // Auto-set the view rectangle
                     else if (it.value().toString() == "auto")
                     {
+                        fig->scene()->setSceneRect(fig->scene()->itemsBounds());
                         fig->setSceneRect(QRectF());
                         fig->fitInView(fig->sceneRect());
+                        fig->notifyZoom();
                     }
                     // Auto-set the view rectangle with equal side size
                     else if (it.value().toString() == "equal")
                     {
+                        fig->scene()->setSceneRect(fig->scene()->itemsBounds());
                         fig->setSceneRect(QRectF());
                         QRectF sceneSize=fig->sceneRect();
                         qreal x, y, w, h;
@@ -351,6 +411,7 @@ VibesWindow::processMessage(const QByteArray &msg_data)
                         //<[#144]
 
                         fig->fitInView(fig->sceneRect());
+                        fig->notifyZoom();
                     }
 
                 }
@@ -364,6 +425,34 @@ VibesWindow::processMessage(const QByteArray &msg_data)
                     bool value = it.value().toBool();
                     fig->setShowAxis(value);
                 }
+                else if (it.key() == "tiledRendering")
+                {
+                    fig->setTiledRendering(it.value().toBool());
+                }
+                else if (it.key() == "progressiveRendering")
+                {
+                    fig->setProgressiveRendering(it.value().toBool());
+                }
+                else if (it.key() == "progressiveSliceTime")
+                {
+                    fig->setProgressiveSliceTime(it.value().toInt());
+                }
+                else if (it.key() == "maxFps")
+                {
+                    fig->setMaxFps(it.value().toInt());
+                }
+                else if (it.key() == "adaptiveQuality")
+                {
+                    fig->setAdaptiveQuality(it.value().toBool());
+                }
+                else if (it.key() == "interactionIdleDelay")
+                {
+                    fig->setInteractionIdleDelay(it.value().toInt());
+                }
+                else if (it.key() == "projectionCacheSize")
+                {
+                    fig->scene()->setProjectionCacheSize(it.value().toInt());
+                }
 
 
             }
@@ -374,30 +463,7 @@ VibesWindow::processMessage(const QByteArray &msg_data)
     {
         return false;
     }
-    const QModelIndex index = ui->treeView->selectionModel()->currentIndex(); //Save the selection before updating 
-
-    ui->treeView->setSelectionMode(QAbstractItemView::MultiSelection); // Save the list of expanded items
-    ui->treeView->selectAll();
-    const QModelIndexList indexList = ui->treeView->selectionModel()->selectedIndexes();
-    ui->treeView->clearSelection();
-    ui->treeView->setSelectionMode(QAbstractItemView::SingleSelection);
-    QHash<QModelIndex,bool> isExpandedList;
-    for(int i = 0; i < indexList.size();i++)
-    {
-        isExpandedList[indexList[i]] = ui->treeView->isExpanded(indexList[i]); 
-    }
-
-    /// \todo Do not force update after each message
-
-    static_cast<VibesTreeModel*> (ui->treeView->model())->forceUpdate();
-
-
-    ui->treeView->selectionModel()->setCurrentIndex(index, QItemSelectionModel::ClearAndSelect | QItemSelectionModel::Rows); //Apply the saved selection
-    for(int i = 0; i < indexList.size();i++)
-    {
-        ui->treeView->setExpanded(indexList[i],isExpandedList[indexList[i]]); // Apply the saved list of expanded items
-    }
-
+    // The tree model follows the figures and their named objects by itself
     return true;
 }
 
@@ -410,7 +476,7 @@ void VibesWindow::editProperties()
     {
         VibesScene2D * scene = figures[selectedFigure]->scene();
         QString selectedGroup = index.data(Qt::DisplayRole).toString();
-        if(scene->namedItems().indexOf(selectedGroup) != -1)
+        if(scene->namedItemRow(selectedGroup) != -1)
         {
             VibesGraphicsItem * item = scene->itemByName(selectedGroup);
             QJsonObject json = PropertyEditDialog::showEditorForJson(item->json());
@@ -421,6 +487,14 @@ void VibesWindow::editProperties()
 
 }
 
+void VibesWindow::filterObjects(const QString &prefix)
+{
+    static_cast<VibesTreeModel*> (ui->treeView->model())->setFilter(prefix);
+    // Matching objects are shown for every figure
+    if (!prefix.isEmpty())
+        ui->treeView->expandAll();
+}
+
 void VibesWindow::closeSingleGraphic()
 {
     //Close selected figure
@@ -430,7 +504,6 @@ void VibesWindow::closeSingleGraphic()
     if(figures.find(selectedFigure) != figures.end()) //Check if a figure is selected (and not a group)
     {
         delete figures[selectedFigure];
-        static_cast<VibesTreeModel*> (ui->treeView->model())->forceUpdate();
     }
 }
 
@@ -473,7 +546,6 @@ void VibesWindow::closeAllGraphics()
                 i.next();
                 delete i.value();
             }
-            static_cast<VibesTreeModel*> (ui->treeView->model())->forceUpdate();
         }
     }
 }
@@ -509,13 +581,9 @@ void VibesWindow::exportCurrentFigureGraphics()
     if (!selectId.isValid())
         return;
     // If the selected item is a figure, export it
-    Figure2D * pfig = 0;
-    if (!selectId.internalPointer())
-        pfig = figures.values().at(selectId.row());
-    else
-        pfig = static_cast<Figure2D*> (selectId.internalPointer());
+    Figure2D * pfig = static_cast<VibesTreeModel*> (ui->treeView->model())->figure(selectId);
 
-    if (figures.values().contains(pfig))
+    if (pfig)
     {
         pfig->exportGraphics();
     }
@@ -533,6 +601,7 @@ void VibesWindow::openHelpDialog()
                                                "Toggle axis view: A\n"
                                                "Change axis ticks: repeated press on X, S, Y, H\n"
                                                "Change font size: * or F and / or V\n"
+                                               "Toggle multithreaded tiled rendering: T\n"
                                                "Default view settings: SPACE"));
 }
 
@@ -564,6 +633,10 @@ void VibesWindow::readFile()
         }
     }
 
+    // Rebuild the graphics of the items changed by this batch of messages
+    foreach (Figure2D *fig, figures)
+        fig->scene()->updateDirtyItems();
+
     // Program new file-read try in 50 ms.
     QTimer::singleShot(50, this, SLOT(readFile()));
 }
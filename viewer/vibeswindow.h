@@ -36,6 +36,7 @@ public slots:
     void hideSingleGraphic();
     void showSingleGraphic();
     void editProperties();
+    void filterObjects(const QString &prefix);
     void openHelpDialog();
 
 private slots: